@@ -54,6 +54,17 @@ int is_same(ptedit_entry_t* e1, ptedit_entry_t* e2) {
     return !diff;
 }
 
+void print_bench(const char* name, int op) {
+    ptedit_bench_t bench;
+    if(ptedit_bench(&target, 0, op, REPEAT, &bench)) {
+        printf(TAG_FAIL "In-kernel %s benchmark failed\n", name);
+        return;
+    }
+    printf(TAG_OK "  in-kernel %-7s: lookup " COLOR_YELLOW "%d" COLOR_RESET ", lock " COLOR_YELLOW "%d" COLOR_RESET
+           ", walk " COLOR_YELLOW "%d" COLOR_RESET ", flush " COLOR_YELLOW "%d" COLOR_RESET " cycles\n", name,
+           (int)(bench.lookup / REPEAT), (int)(bench.lock / REPEAT), (int)(bench.walk / REPEAT), (int)(bench.flush / REPEAT));
+}
+
 int main(int argc, char *argv[]) {
     if (ptedit_init()) {
       printf(TAG_FAIL "Error: Could not initalize PTEditor, did you load the kernel module?\n");
@@ -74,6 +85,10 @@ int main(int argc, char *argv[]) {
     }
     stop = rdtsc();
     printf(TAG_OK "Kernel implementation takes " COLOR_YELLOW "%d" COLOR_RESET " cycles/resolve\n", (int)((stop - start) / REPEAT));
+    // the remainder of the cycles above is spent entering and leaving the kernel and copying the entry
+    print_bench("resolve", PTEDITOR_BENCH_RESOLVE);
+    print_bench("update", PTEDITOR_BENCH_UPDATE);
+    print_bench("flush", PTEDITOR_BENCH_FLUSH);
     
     ptedit_use_implementation(PTEDIT_IMPL_USER);
     start = rdtsc();
@@ -12,10 +12,40 @@
 #include <linux/ptrace.h>
 #include <linux/proc_fs.h>
 #include <linux/kprobes.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/kthread.h>
+#include <linux/pid_namespace.h>
+#include <linux/anon_inodes.h>
+#include <linux/uio.h>
+#include <linux/poll.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/timex.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+#include <linux/mmu_notifier.h>
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/mm.h>
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
+#include <linux/mmu_context.h>
+#define kthread_use_mm(mm) use_mm(mm)
+#define kthread_unuse_mm(mm) unuse_mm(mm)
+#endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
 #include <linux/mmap_lock.h>
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h>
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#include <linux/io_uring.h>
+#endif
 
 //#ifdef CONFIG_PAGE_TABLE_ISOLATION
 //pgd_t __attribute__((weak)) __pti_set_user_pgtbl(pgd_t *pgdp, pgd_t pgd);
@@ -23,8 +53,40 @@
 
 static int real_page_size = 4096, real_page_shift = 12;
 
+/* Ranged TLB flushes covering more pages than this flush the whole mm instead */
+#define PTEDITOR_FLUSH_ALL_THRESHOLD 64
+
+/* Number of ioctl numbers with statistics, and of log2 buckets (in ns) of the latency histograms */
+#define PTEDITOR_STATS_CMDS 64
+#define PTEDITOR_STATS_BUCKETS 32
+
+/* Number of invalidation ranges a transaction records before merging them */
+#define PTEDITOR_TXN_RANGES 256
+
+/* The ring polling thread sleeps after it did not find any request for this time */
+#define PTEDITOR_RING_IDLE_MS 10
+
+/* Size of the buffer of a page-table dump, it is refilled whenever it was read entirely. It holds at least an entry of
+ * every level and a full page table on top of 128 KiB, such that every refill makes progress (e.g., with 64K pages). */
+#define PTEDITOR_DUMP_BUFFER (128 * 1024 + (PTRS_PER_PTE + 4) * sizeof(ptedit_dump_record_t))
+
+/* Number of pages harvested while holding the mmap lock, i.e., one page of bitmap */
+#define PTEDITOR_HARVEST_CHUNK (PAGE_SIZE * 8)
+
+/* Number of records a watch queues before they are replaced by a single overflow record */
+#define PTEDITOR_WATCH_QUEUE 1024
+
+/* Number of entries a PTE file reads or writes while holding the mmap lock */
+#define PTEDITOR_PTE_FILE_CHUNK 512
+
+/* Number of pages of a physical run copied between two rescheduling points */
+#define PTEDITOR_PHYS_CHUNK 512
+
 #include "pteditor.h"
 
+#define CREATE_TRACE_POINTS
+#include "pteditor_trace.h"
+
 MODULE_AUTHOR("Michael Schwarz");
 MODULE_DESCRIPTION("Device to play around with paging structures");
 MODULE_LICENSE("GPL");
@@ -101,6 +163,21 @@ static inline int pmd_large(pmd_t pmd) {
 #define pmd_leaf pmd_large
 #endif
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 11, 0)
+#define mmgrab(mm) atomic_inc(&(mm)->mm_count)
+#define mmget_not_zero(mm) atomic_inc_not_zero(&(mm)->mm_users)
+#endif
+
+/* Since 6.5, pte_offset_map() takes the RCU read lock (released by pte_unmap()),
+ * we only read the page table and use pte_offset_kernel() instead */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 5, 0)
+#define map_pte(pmd, addr) pte_offset_map(pmd, addr)
+#define unmap_pte(pte) pte_unmap(pte)
+#else
+#define map_pte(pmd, addr) pte_offset_kernel(pmd, addr)
+#define unmap_pte(pte) do { } while(0)
+#endif
+
 #ifdef pr_fmt
 #undef pr_fmt
 #endif
@@ -131,29 +208,271 @@ typedef struct {
     size_t valid;
 } vm_t;
 
-static bool device_busy = false;
-static bool mm_is_locked = false;
+typedef struct {
+  struct mm_struct* mm;
+  unsigned long start, end;
+} txn_range_t;
+
+/* State of an open file, the device can be opened by any number of processes */
+typedef struct {
+  /* Protects the mm lock state */
+  struct mutex lock;
+  bool mm_is_locked;
+  struct mm_struct* locked_mm;
+  /*
+   * With VM_LOCK_RANGE, only the range can be updated. No lock is held, instead an mmu_notifier
+   * lets updates of the range and changes of its mappings wait for each other (range_lock protects the counts).
+   * range_seq is advanced at the start and the end of every change of the range, updates fail with -EAGAIN
+   * if it differs from range_resolved_seq, i.e., the value of the last resolve.
+   */
+  bool range_locked;
+  unsigned long lock_start, lock_end;
+  spinlock_t range_lock;
+  size_t range_updates, range_invalidations;
+  size_t range_seq, range_resolved_seq;
+  wait_queue_head_t range_wait;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+  struct mmu_notifier range_notifier;
+#endif
+
+  /*
+   * With ATTACH, the mm of attached_pid is grabbed until DETACH or until the file is released.
+   * Requests hold attach_sem for reading and mm_users of the attached mm while they run.
+   */
+  struct rw_semaphore attach_sem;
+  pid_t attached_pid;
+  struct mm_struct* attached_mm;
+
+  void (*invalidate_tlb)(struct mm_struct*, void*);
+  void (*invalidate_tlb_range)(struct mm_struct*, unsigned long, unsigned long);
+
+  /* Number of resolves served by each path (PTEDITOR_RESOLVE_PATH_*) */
+  atomic64_t resolve_path[PTEDITOR_RESOLVE_PATHS];
+
+  /* Protects the transaction, it is taken while holding an mm lock */
+  struct mutex txn_lock;
+  struct {
+    bool active;
+    size_t count;
+    size_t requested;
+    txn_range_t ranges[PTEDITOR_TXN_RANGES];
+  } txn;
+
+  /* Command ring shared with user space, ring_head is the kernel's copy of the completion counter */
+  struct mutex ring_lock;
+  ptedit_ring_t* ring;
+  size_t ring_head;
+  /*
+   * With PTEDITOR_RING_SQPOLL, the ring is processed by a thread using the mm of the creator. Only mm_count
+   * is held, such that the ring mapping does not keep the address space (and thereby the file) alive.
+   * Pids of requests are resolved in the pid namespace of the creator, pid 0 is the creating thread.
+   */
+  struct task_struct* ring_thread;
+  struct mm_struct* ring_mm;
+  struct pid* ring_pid;
+  struct pid_namespace* ring_ns;
+  /* Set once the thread ended on its own, later requests are never completed */
+  bool ring_exited;
+
+  /* Range whose page tables are mapped by the next mmap at PTEDITOR_MMAP_PAGE_TABLES (PT_MAP) */
+  ptedit_pt_map_t pt_map;
+} pteditor_ctx_t;
+
+/* Page tables mapped into user space, the references keep them from being reused after they are freed */
+typedef struct {
+  atomic_t users;
+  size_t count;
+  struct page* pages[];
+} pt_mapping_t;
 
-void (*invalidate_tlb)(pid_t, void*);
 void (*flush_tlb_mm_range_func)(struct mm_struct*, unsigned long, unsigned long, unsigned int, bool);
+#if (defined(__i386__) || defined(__x86_64__)) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+void (*flush_tlb_one_user_func)(unsigned long);
+void (*flush_tlb_local_func)(void);
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0) && defined(CONFIG_PER_VMA_LOCK)
+struct vm_area_struct* (*lock_vma_under_rcu_func)(struct mm_struct*, unsigned long);
+#endif
 void (*native_write_cr4_func)(unsigned long);
-static struct mm_struct* get_mm(size_t);
+static struct mm_struct* get_mm(pteditor_ctx_t*, size_t);
+static void invalidate_tlb_kernel(struct mm_struct*, void*);
+static void invalidate_tlb_range_kernel(struct mm_struct*, unsigned long, unsigned long);
+static void unlock_mm(pteditor_ctx_t*);
+static int txn_commit(pteditor_ctx_t*, ptedit_txn_t*);
+static void ring_destroy(pteditor_ctx_t*);
+static void* alloc_buffer(size_t);
+
+/*
+ * Module-wide statistics exported via debugfs (pteditor/stats, written to pteditor/reset). They are
+ * counted per CPU, such that counting does not contend, and summed up when read.
+ */
+typedef struct {
+  u64 calls[PTEDITOR_STATS_CMDS];
+  u64 errors[PTEDITOR_STATS_CMDS];
+  u64 time_ns[PTEDITOR_STATS_CMDS];
+  u64 latency[PTEDITOR_STATS_CMDS][PTEDITOR_STATS_BUCKETS];
+  u64 lock_calls, lock_contended, lock_wait_ns;
+  u64 flushes, flush_ns;
+  u64 flush_latency[PTEDITOR_STATS_BUCKETS];
+  /* Resolves by the deepest valid level (0 for none, 1 for the PGD, ..., 5 for the PTE) */
+  u64 walk_end[6];
+} pteditor_stats_t;
+
+static pteditor_stats_t __percpu* pteditor_stats;
+static struct dentry* stats_dir;
+
+#define STATS_CMD(name) [_IOC_NR(PTEDITOR_IOCTL_CMD_##name)] = #name
+static const char* const stats_cmd_names[PTEDITOR_STATS_CMDS] = {
+  STATS_CMD(VM_RESOLVE), STATS_CMD(VM_UPDATE), STATS_CMD(VM_LOCK), STATS_CMD(VM_UNLOCK),
+  STATS_CMD(READ_PAGE), STATS_CMD(WRITE_PAGE), STATS_CMD(GET_ROOT), STATS_CMD(SET_ROOT),
+  STATS_CMD(GET_PAGESIZE), STATS_CMD(INVALIDATE_TLB), STATS_CMD(GET_PAT), STATS_CMD(SET_PAT),
+  STATS_CMD(SWITCH_TLB_INVALIDATION), STATS_CMD(INVALIDATE_TLB_PID), STATS_CMD(VM_RESOLVE_BATCH),
+  STATS_CMD(VM_UPDATE_BATCH), STATS_CMD(VM_RESOLVE_RANGE), STATS_CMD(VM_PTE_MODIFY_RANGE),
+  STATS_CMD(VM_CMPXCHG), STATS_CMD(TXN_BEGIN), STATS_CMD(TXN_COMMIT), STATS_CMD(VM_LOCK_RANGE),
+  STATS_CMD(RESOLVE_STATS), STATS_CMD(ATTACH), STATS_CMD(RING_SETUP), STATS_CMD(RING_ENTER),
+  STATS_CMD(PT_MAP), STATS_CMD(READ_PAGES), STATS_CMD(WRITE_PAGES), STATS_CMD(COPY_PAGES),
+  STATS_CMD(FILL_PAGES), STATS_CMD(CLEAR_PAGES), STATS_CMD(DUMP_OPEN), STATS_CMD(PTE_FILE_OPEN),
+  STATS_CMD(HARVEST), STATS_CMD(WATCH_OPEN), STATS_CMD(INVALIDATE_TLB_RANGE), STATS_CMD(SHOOTDOWN),
+  STATS_CMD(BENCH), STATS_CMD(DETACH),
+};
 
-static int device_open(struct inode *inode, struct file *file) {
-  /* Check if device is busy */
-  if (device_busy == true) {
-    return -EBUSY;
+static inline u64 stats_now(void) {
+  return pteditor_stats ? ktime_get_ns() : 0;
+}
+
+/* Bucket i counts durations in [2^i, 2^(i + 1)) ns */
+static inline int stats_bucket(u64 ns) {
+  return ns ? min_t(int, ilog2(ns), PTEDITOR_STATS_BUCKETS - 1) : 0;
+}
+
+static void stats_ioctl(unsigned int cmd, u64 start, long ret) {
+  unsigned int nr = _IOC_NR(cmd);
+  u64 ns;
+  if(!pteditor_stats || nr >= PTEDITOR_STATS_CMDS) return;
+  ns = ktime_get_ns() - start;
+  this_cpu_inc(pteditor_stats->calls[nr]);
+  if(ret < 0) this_cpu_inc(pteditor_stats->errors[nr]);
+  this_cpu_add(pteditor_stats->time_ns[nr], ns);
+  this_cpu_inc(pteditor_stats->latency[nr][stats_bucket(ns)]);
+}
+
+static void stats_lock(int contended, u64 start) {
+  if(!pteditor_stats) return;
+  this_cpu_inc(pteditor_stats->lock_calls);
+  if(!contended) return;
+  this_cpu_inc(pteditor_stats->lock_contended);
+  this_cpu_add(pteditor_stats->lock_wait_ns, ktime_get_ns() - start);
+}
+
+static void stats_flush(u64 start) {
+  u64 ns;
+  if(!pteditor_stats) return;
+  ns = ktime_get_ns() - start;
+  this_cpu_inc(pteditor_stats->flushes);
+  this_cpu_add(pteditor_stats->flush_ns, ns);
+  this_cpu_inc(pteditor_stats->flush_latency[stats_bucket(ns)]);
+}
+
+static void stats_walk(size_t valid) {
+  if(pteditor_stats) this_cpu_inc(pteditor_stats->walk_end[fls(valid & 0x1f)]);
+}
+
+static void stats_show_histogram(struct seq_file* m, u64* buckets) {
+  int i;
+  for(i = 0; i < PTEDITOR_STATS_BUCKETS; i++) {
+    if(buckets[i]) seq_printf(m, " %d:%llu", i, buckets[i]);
+  }
+  seq_putc(m, '\n');
+}
+
+static int stats_show(struct seq_file* m, void* v) {
+  pteditor_stats_t* sum = alloc_buffer(sizeof(pteditor_stats_t));
+  u64 *dst, *src;
+  size_t i;
+  int cpu;
+
+  if(!sum) return -ENOMEM;
+  memset(sum, 0, sizeof(pteditor_stats_t));
+  for_each_possible_cpu(cpu) {
+    dst = (u64*)sum;
+    src = (u64*)per_cpu_ptr(pteditor_stats, cpu);
+    for(i = 0; i < sizeof(pteditor_stats_t) / sizeof(u64); i++) dst[i] += src[i];
+  }
+
+  seq_printf(m, "%-24s %12s %12s %16s  latency (log2 ns:calls)\n", "command", "calls", "errors", "ns");
+  for(i = 0; i < PTEDITOR_STATS_CMDS; i++) {
+    if(!sum->calls[i]) continue;
+    if(stats_cmd_names[i]) seq_printf(m, "%-24s", stats_cmd_names[i]);
+    else seq_printf(m, "%-24zu", i);
+    seq_printf(m, " %12llu %12llu %16llu ", sum->calls[i], sum->errors[i], sum->time_ns[i]);
+    stats_show_histogram(m, sum->latency[i]);
+  }
+  seq_printf(m, "\nmmap_lock: %llu acquired, %llu contended, %llu ns waited\n",
+             sum->lock_calls, sum->lock_contended, sum->lock_wait_ns);
+  seq_printf(m, "tlb_flush: %llu flushes, %llu ns, latency (log2 ns:flushes)", sum->flushes, sum->flush_ns);
+  stats_show_histogram(m, sum->flush_latency);
+  seq_printf(m, "resolve_walk_end: none %llu, pgd %llu, p4d %llu, pud %llu, pmd %llu, pte %llu\n",
+             sum->walk_end[0], sum->walk_end[1], sum->walk_end[2], sum->walk_end[3], sum->walk_end[4], sum->walk_end[5]);
+
+  kvfree(sum);
+  return 0;
+}
+
+static int stats_open(struct inode* inode, struct file* file) {
+  return single_open(file, stats_show, NULL);
+}
+
+static const struct file_operations stats_ops = {
+  .owner = THIS_MODULE,
+  .open = stats_open,
+  .read = seq_read,
+  .llseek = seq_lseek,
+  .release = single_release,
+};
+
+/* Any write resets all statistics, counters updated concurrently may survive */
+static ssize_t stats_reset(struct file* file, const char __user* buffer, size_t size, loff_t* offset) {
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    memset(per_cpu_ptr(pteditor_stats, cpu), 0, sizeof(pteditor_stats_t));
   }
+  return size;
+}
+
+static const struct file_operations stats_reset_ops = {
+  .owner = THIS_MODULE,
+  .write = stats_reset,
+};
 
-  device_busy = true;
+static int device_open(struct inode *inode, struct file *file) {
+  pteditor_ctx_t* ctx = kzalloc(sizeof(pteditor_ctx_t), GFP_KERNEL);
+  if(!ctx) return -ENOMEM;
+
+  mutex_init(&ctx->lock);
+  mutex_init(&ctx->txn_lock);
+  mutex_init(&ctx->ring_lock);
+  spin_lock_init(&ctx->range_lock);
+  init_waitqueue_head(&ctx->range_wait);
+  init_rwsem(&ctx->attach_sem);
+  // we use the kernel TLB invalidation function by default as it's more reliable
+  ctx->invalidate_tlb = invalidate_tlb_kernel;
+  ctx->invalidate_tlb_range = invalidate_tlb_range_kernel;
+  file->private_data = ctx;
 
   return 0;
 }
 
 static int device_release(struct inode *inode, struct file *file) {
-  /* Unlock module */
-  device_busy = false;
+  pteditor_ctx_t* ctx = file->private_data;
+  ptedit_txn_t result;
 
+  /* Release an mm lock and flush invalidations of a transaction that the process left behind */
+  ring_destroy(ctx);
+  unlock_mm(ctx);
+  txn_commit(ctx, &result);
+  if(ctx->attached_mm) mmdrop(ctx->attached_mm);
+
+  kfree(ctx);
   return 0;
 }
 
@@ -171,38 +490,208 @@ _invalidate_tlb(void *addr) {
 }
 
 static void
-invalidate_tlb_custom(pid_t pid, void* addr) {
+invalidate_tlb_custom(struct mm_struct* mm, void* addr) {
+  u64 start = stats_now();
+#if defined(__aarch64__)
+  // TLBI instructions are broadcast to all CPUs in the inner-shareable domain
+  _invalidate_tlb(addr);
+#else
   on_each_cpu(_invalidate_tlb, addr, 1);
+#endif
+  stats_flush(start);
 }
 
-#if defined(__aarch64__)
-typedef struct tlb_page_s {
-  struct vm_area_struct* vma;
-  unsigned long addr;
-} tlb_page_t;
-
-void _flush_tlb_page_smp(void* info) {
-  tlb_page_t* tlb_page = (tlb_page_t*) info;
-  flush_tlb_page(tlb_page->vma, tlb_page->addr);
+static void
+invalidate_tlb_range_custom(struct mm_struct* mm, unsigned long start, unsigned long end) {
+  // the custom invalidation always flushes the entire TLB
+  invalidate_tlb_custom(mm, (void*) start);
 }
-#endif
 
 static void
-invalidate_tlb_kernel(pid_t pid, void* addr) {
+invalidate_tlb_kernel(struct mm_struct* mm, void* addr) {
+  u64 start = stats_now();
 #if defined(__i386__) || defined(__x86_64__)
-  struct mm_struct* mm = get_mm(pid);
   if (!mm) return; // process might have already been killed
   flush_tlb_mm_range_func(mm, (unsigned long) addr, (unsigned long) addr + real_page_size, real_page_shift, false);
 #elif defined(__aarch64__)
-  struct vm_area_struct *vma = find_vma(current->mm, (unsigned long)addr);
-  tlb_page_t tlb_page;
-  if (unlikely(vma == NULL || (unsigned long)addr < vma->vm_start)) {
+  if (!mm) return; // process might have already been killed
+  /* Like flush_tlb_page, but without a VMA: the ASID of mm selects the entries, and TLBI is broadcast to all CPUs */
+  dsb(ishst);
+  __tlbi(vae1is, __TLBI_VADDR((unsigned long)addr, ASID(mm)));
+  __tlbi_user(vae1is, __TLBI_VADDR((unsigned long)addr, ASID(mm)));
+  dsb(ish);
+#endif
+  stats_flush(start);
+}
+
+static void
+invalidate_tlb_range_kernel(struct mm_struct* mm, unsigned long start, unsigned long end) {
+  int flush_all = ((end - start) >> real_page_shift) > PTEDITOR_FLUSH_ALL_THRESHOLD;
+  u64 begin = stats_now();
+#if defined(__i386__) || defined(__x86_64__)
+  if(flush_all) {
+    flush_tlb_mm_range_func(mm, 0, TLB_FLUSH_ALL, 0, false);
+  } else {
+    flush_tlb_mm_range_func(mm, start, end, real_page_shift, false);
+  }
+#elif defined(__aarch64__)
+  struct vm_area_struct *vma = find_vma(mm, start);
+  // TLBI instructions are broadcast to all CPUs in the inner-shareable domain
+  if(flush_all || unlikely(vma == NULL || start < vma->vm_start)) {
+    flush_tlb_mm(mm);
+  } else {
+    flush_tlb_range(vma, start, end);
+  }
+#endif
+  stats_flush(begin);
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+/* Returns whether the address space loaded on a CPU can be flushed without the kernel path */
+static int can_flush_tlb_loaded(void) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  return flush_tlb_one_user_func && flush_tlb_local_func;
+#else
+  return 1;
+#endif
+}
+
+/* Invalidates a range of the address space loaded on the current CPU, the caller disables preemption */
+static void flush_tlb_loaded_range(unsigned long start, unsigned long end, unsigned long stride) {
+  unsigned long i, count = DIV_ROUND_UP(end - start, stride);
+  if(count > PTEDITOR_FLUSH_ALL_THRESHOLD) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    flush_tlb_local_func();
+#else
+    __flush_tlb();
+#endif
     return;
   }
-  tlb_page.vma = vma;
-  tlb_page.addr = (unsigned long)addr;
-  on_each_cpu(_flush_tlb_page_smp, &tlb_page, 1);
+  for(i = 0; i < count; i++) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    flush_tlb_one_user_func(start + i * stride);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 16, 0)
+    __flush_tlb_one_user(start + i * stride);
+#else
+    __flush_tlb_single(start + i * stride);
+#endif
+  }
+}
+#endif
+
+/*
+ * Invalidates a range on the current CPU only. On x86, TLB entries of an address space that is not loaded
+ * are only invalidated when switching to it, which requires the kernel path (i.e., the mm scope).
+ */
+static int
+invalidate_tlb_local(struct mm_struct* mm, unsigned long start, unsigned long end, unsigned long stride) {
+  u64 begin = stats_now();
+#if defined(__i386__) || defined(__x86_64__)
+  if(mm != current->mm) return -EINVAL;
+  if(!can_flush_tlb_loaded()) return -EOPNOTSUPP;
+  preempt_disable();
+  flush_tlb_loaded_range(start, end, stride);
+  preempt_enable();
+#elif defined(__aarch64__)
+  // non-broadcast TLBI, the entries of all address spaces are dropped as the ASID can be reused
+  local_flush_tlb_all();
+#endif
+  stats_flush(begin);
+  return 0;
+}
+
+/*
+ * Invalidates the ranges of multiple address spaces, the ranges are sorted by mm. On x86, every mm is flushed once
+ * by the kernel over the span of its ranges, which keeps the TLB generations consistent and only interrupts the CPUs
+ * that used the mm. On arm64, TLBIs are broadcast, only the barriers are shared.
+ * Returns the number of flushes issued, i.e., the number of mms.
+ */
+static long shootdown(txn_range_t* ranges, size_t count) {
+  u64 start = stats_now();
+  long issued = 0;
+  size_t i;
+#if defined(__i386__) || defined(__x86_64__)
+  unsigned long end;
+  size_t first;
+
+  for(first = 0; first < count; first = i, issued++) {
+    end = ranges[first].end;
+    for(i = first + 1; i < count && ranges[i].mm == ranges[first].mm; i++) end = max(end, ranges[i].end);
+    if(((end - ranges[first].start) >> PAGE_SHIFT) > PTEDITOR_FLUSH_ALL_THRESHOLD) {
+      flush_tlb_mm_range_func(ranges[first].mm, 0, TLB_FLUSH_ALL, 0, false);
+    } else {
+      flush_tlb_mm_range_func(ranges[first].mm, ranges[first].start, end, PAGE_SHIFT, false);
+    }
+  }
+#elif defined(__aarch64__)
+  unsigned long addr, asid;
+
+  dsb(ishst);
+  for(i = 0; i < count; i++) {
+    if(!i || ranges[i].mm != ranges[i - 1].mm) issued++;
+    asid = __TLBI_VADDR(0, ASID(ranges[i].mm));
+    if(((ranges[i].end - ranges[i].start) >> PAGE_SHIFT) > PTEDITOR_FLUSH_ALL_THRESHOLD) {
+      __tlbi(aside1is, asid);
+      __tlbi_user(aside1is, asid);
+      continue;
+    }
+    for(addr = ranges[i].start; addr < ranges[i].end; addr += PAGE_SIZE) {
+      __tlbi(vae1is, __TLBI_VADDR(addr, ASID(ranges[i].mm)));
+      __tlbi_user(vae1is, __TLBI_VADDR(addr, ASID(ranges[i].mm)));
+    }
+  }
+  dsb(ish);
+#endif
+  stats_flush(start);
+  return issued;
+}
+
+/* Invalidates a range with the given stride and scope, bypassing transactions as the scope is explicit */
+static long invalidate_tlb_scoped(pteditor_ctx_t* ctx, ptedit_invalidate_tlb_range_t* args) {
+  unsigned long stride = args->stride ? args->stride : PAGE_SIZE;
+  unsigned long start = args->start & ~(stride - 1), end = args->end;
+  struct mm_struct* mm;
+  int flush_all;
+  u64 begin;
+
+  if(stride != PAGE_SIZE && stride != PMD_SIZE && stride != PUD_SIZE) return -EINVAL;
+  if(end <= start) return -EINVAL;
+  flush_all = (end - start) / stride > PTEDITOR_FLUSH_ALL_THRESHOLD;
+
+  switch(args->scope) {
+    case PTEDITOR_TLB_SCOPE_LOCAL:
+      return invalidate_tlb_local(get_mm(ctx, args->pid), start, end, stride);
+    case PTEDITOR_TLB_SCOPE_MM:
+      mm = get_mm(ctx, args->pid);
+      if(!mm) return -ESRCH;
+#if defined(__i386__) || defined(__x86_64__)
+      // only CPUs in mm_cpumask are interrupted, the others flush lazily on their next switch to mm
+      begin = stats_now();
+      if(flush_all) {
+        flush_tlb_mm_range_func(mm, 0, TLB_FLUSH_ALL, 0, false);
+      } else {
+        flush_tlb_mm_range_func(mm, start, end, ilog2(stride), false);
+      }
+      stats_flush(begin);
+#elif defined(__aarch64__)
+      // finding the VMA requires the mmap lock
+      if(needs_lock(ctx, args->pid)) {
+        lock_mm_read(mm);
+        invalidate_tlb_range_kernel(mm, start, end);
+        unlock_mm_read(mm);
+      } else {
+        invalidate_tlb_range_kernel(mm, start, end);
+      }
 #endif
+      return 0;
+    case PTEDITOR_TLB_SCOPE_ALL:
+      begin = stats_now();
+      flush_tlb_all();
+      stats_flush(begin);
+      return 0;
+    default:
+      return -EINVAL;
+  }
 }
 
 static void _set_pat(void* _pat) {
@@ -218,271 +707,2708 @@ static void _set_pat(void* _pat) {
 #endif
 }
 
-static void set_pat(size_t pat) {
-    on_each_cpu(_set_pat, (void*) pat, 1);
+static void set_pat(size_t pat) {
+    on_each_cpu(_set_pat, (void*) pat, 1);
+}
+
+/* Returns the task of a pid given in a request (0 for the own process) */
+static struct task_struct* get_task(pteditor_ctx_t* ctx, size_t pid) {
+  struct pid* vpid;
+
+  /* The polling thread of a ring serves the process that created it */
+  if(current == ctx->ring_thread) {
+    vpid = pid ? find_pid_ns(pid, ctx->ring_ns) : ctx->ring_pid;
+  } else {
+    if(pid == 0) return current;
+    vpid = find_vpid(pid);
+  }
+  if(!vpid) return NULL;
+  return pid_task(vpid, PIDTYPE_PID);
+}
+
+static struct mm_struct* get_mm(pteditor_ctx_t* ctx, size_t pid) {
+  struct task_struct *task;
+  struct mm_struct* attached = ctx->attached_mm;
+
+  /* The request pinned the attached mm in attach_enter, no lookup required unless the process exited */
+  if(attached && pid != 0 && (pid_t)pid == ctx->attached_pid && atomic_read(&attached->mm_users)) return attached;
+  /* The polling thread of a ring holds mm_users of the creator's mm while it processes requests */
+  if(pid == 0 && current == ctx->ring_thread) return ctx->ring_mm;
+
+  /* Find mm */
+  task = get_task(ctx, pid);
+  if(!task) return NULL;
+  if(task->mm) {
+      return task->mm;
+  } else {
+      return task->active_mm;
+  }
+  return NULL;
+}
+
+/* Global process id of a pid given in a request (0 if there is no such process) */
+static pid_t request_tgid(pteditor_ctx_t* ctx, size_t pid) {
+  struct task_struct* task;
+  pid_t tgid = 0;
+
+  rcu_read_lock();
+  task = get_task(ctx, pid);
+  if(task) tgid = task_tgid_nr(task);
+  rcu_read_unlock();
+  return tgid;
+}
+
+/* The process id for the update tracepoint, only looked up while the tracepoint is enabled */
+static pid_t trace_tgid(pteditor_ctx_t* ctx, size_t pid) {
+  return trace_pteditor_update_enabled() ? request_tgid(ctx, pid) : 0;
+}
+
+/* Grabs the mm of pid until it is detached, later requests for pid use it without a lookup */
+static int attach_mm(pteditor_ctx_t* ctx, pid_t pid) {
+  struct task_struct *task = current;
+  struct mm_struct* mm;
+  int ret = 0;
+
+  if(pid != 0) {
+    rcu_read_lock();
+    task = pid_task(find_vpid(pid), PIDTYPE_PID);
+    if(task) get_task_struct(task);
+    rcu_read_unlock();
+    if(!task) return -ESRCH;
+  }
+  /* Only the mm_struct is kept, the address space itself is only pinned while a request runs */
+  mm = get_task_mm(task);
+  if(pid != 0) put_task_struct(task);
+  if(!mm) return -ESRCH;
+  mmgrab(mm);
+  mmput(mm);
+
+  down_write(&ctx->attach_sem);
+  if(ctx->attached_mm) {
+    ret = -EBUSY;
+  } else {
+    ctx->attached_pid = pid ? pid : task_tgid_vnr(current);
+    ctx->attached_mm = mm;
+  }
+  up_write(&ctx->attach_sem);
+
+  if(ret) mmdrop(mm);
+  return ret;
+}
+
+static int detach_mm(pteditor_ctx_t* ctx) {
+  struct mm_struct* mm;
+
+  /* Waits for all running requests that use the attached mm */
+  down_write(&ctx->attach_sem);
+  mm = ctx->attached_mm;
+  ctx->attached_mm = NULL;
+  ctx->attached_pid = 0;
+  up_write(&ctx->attach_sem);
+
+  if(!mm) return -EINVAL;
+  mmdrop(mm);
+  return 0;
+}
+
+/* Pins the attached mm for a request, returns NULL if nothing is attached or the process exited */
+static struct mm_struct* attach_enter(pteditor_ctx_t* ctx) {
+  struct mm_struct* mm;
+
+  down_read(&ctx->attach_sem);
+  mm = ctx->attached_mm;
+  if(mm && !mmget_not_zero(mm)) mm = NULL;
+  return mm;
+}
+
+static void attach_leave(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  if(mm) mmput(mm);
+  up_read(&ctx->attach_sem);
+}
+
+static void lock_mm_read(struct mm_struct* mm) {
+  u64 start;
+  /* Only waiting for the lock is timed */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  if(mmap_read_trylock(mm)) {
+    stats_lock(0, 0);
+    return;
+  }
+  start = stats_now();
+  mmap_read_lock(mm);
+#else
+  if(down_read_trylock(&mm->mmap_sem)) {
+    stats_lock(0, 0);
+    return;
+  }
+  start = stats_now();
+  down_read(&mm->mmap_sem);
+#endif
+  stats_lock(1, start);
+}
+
+static void unlock_mm_read(struct mm_struct* mm) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  mmap_read_unlock(mm);
+#else
+  up_read(&mm->mmap_sem);
+#endif
+}
+
+/* Releases the mm locked with PTEDITOR_IOCTL_CMD_VM_LOCK or PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE */
+static void unlock_mm(pteditor_ctx_t* ctx) {
+  struct mm_struct *mm;
+
+  mutex_lock(&ctx->lock);
+  mm = ctx->locked_mm;
+  if(ctx->mm_is_locked && mm && ctx->range_locked) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+    /* Waits for running callbacks */
+    mmu_notifier_unregister(&ctx->range_notifier, mm);
+#endif
+    mmdrop(mm);
+  } else if(ctx->mm_is_locked && mm) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    mmap_write_unlock(mm);
+    mmap_read_unlock(mm);
+#else
+    up_write(&mm->mmap_sem);
+    up_read(&mm->mmap_sem);
+#endif
+    mmdrop(mm);
+  }
+  ctx->locked_mm = NULL;
+  ctx->mm_is_locked = false;
+  ctx->range_locked = false;
+  mutex_unlock(&ctx->lock);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+/*
+ * Called before the mappings of a range change (munmap, mprotect, migration, reclaim, ...). A change of
+ * the locked range waits for running updates of it, and further updates wait until the change is done.
+ */
+static int range_invalidate_range_start(struct mmu_notifier* notifier, const struct mmu_notifier_range* range) {
+  pteditor_ctx_t* ctx = container_of(notifier, pteditor_ctx_t, range_notifier);
+
+  if(range->start >= ctx->lock_end || range->end <= ctx->lock_start) return 0;
+  spin_lock(&ctx->range_lock);
+  while(ctx->range_updates) {
+    spin_unlock(&ctx->range_lock);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+    if(!mmu_notifier_range_blockable(range)) return -EAGAIN;
+#else
+    if(!range->blockable) return -EAGAIN;
+#endif
+    wait_event(ctx->range_wait, !READ_ONCE(ctx->range_updates));
+    spin_lock(&ctx->range_lock);
+  }
+  ctx->range_invalidations++;
+  smp_store_release(&ctx->range_seq, ctx->range_seq + 1);
+  spin_unlock(&ctx->range_lock);
+  return 0;
+}
+
+static void range_invalidate_range_end(struct mmu_notifier* notifier, const struct mmu_notifier_range* range) {
+  pteditor_ctx_t* ctx = container_of(notifier, pteditor_ctx_t, range_notifier);
+
+  if(range->start >= ctx->lock_end || range->end <= ctx->lock_start) return;
+  spin_lock(&ctx->range_lock);
+  ctx->range_invalidations--;
+  smp_store_release(&ctx->range_seq, ctx->range_seq + 1);
+  spin_unlock(&ctx->range_lock);
+  wake_up(&ctx->range_wait);
+}
+
+static const struct mmu_notifier_ops range_notifier_ops = {
+  .invalidate_range_start = range_invalidate_range_start,
+  .invalidate_range_end = range_invalidate_range_end,
+};
+#endif
+
+/*
+ * Pins a range of an address space. No lock is held while returning to user space, i.e., neither page faults
+ * nor changes of other mappings are blocked. Instead, an mmu_notifier serializes updates of the range with
+ * changes of its mappings. Updates in the range take the mmap lock for reading like any other update and the
+ * split page-table locks for every entry. As resolve and update are separate requests, updates of entries that
+ * might be stale fail with -EAGAIN (see range_enter_resolved).
+ */
+static int lock_mm_range(pteditor_ctx_t* ctx, ptedit_lock_range_t* range) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+  struct mm_struct *mm;
+  struct vm_area_struct *vma;
+  unsigned long start = range->vaddr & PAGE_MASK;
+  unsigned long end = PAGE_ALIGN(range->vaddr + range->length);
+  unsigned long addr;
+  int ret = 0;
+
+  if(end <= start) return -EINVAL;
+
+  mutex_lock(&ctx->lock);
+  if(ctx->mm_is_locked) {
+    pr_warn("VM is already locked\n");
+    ret = -EBUSY;
+    goto out;
+  }
+  mm = get_mm(ctx, range->pid);
+  if(!mm || !mmget_not_zero(mm)) {
+    ret = -ESRCH;
+    goto out;
+  }
+
+  /* The range is set before registering, as the callbacks run as soon as the notifier is registered */
+  ctx->lock_start = start;
+  ctx->lock_end = end;
+  ctx->range_seq = ctx->range_resolved_seq = 0;
+  ctx->range_notifier.ops = &range_notifier_ops;
+  /* Registering takes the mmap lock for writing */
+  ret = mmu_notifier_register(&ctx->range_notifier, mm);
+  if(ret) {
+    mmput(mm);
+    goto out;
+  }
+
+  lock_mm_read(mm);
+  /* The range has to be mapped entirely */
+  for(addr = start; addr < end; addr = vma->vm_end) {
+    vma = find_vma(mm, addr);
+    if(!vma || vma->vm_start > addr) {
+      ret = -EFAULT;
+      break;
+    }
+  }
+  unlock_mm_read(mm);
+  if(ret) {
+    mmu_notifier_unregister(&ctx->range_notifier, mm);
+    mmput(mm);
+    goto out;
+  }
+
+  /* Only mm_count is held, the range does not keep the address space alive */
+  mmgrab(mm);
+  mmput(mm);
+  ctx->locked_mm = mm;
+  ctx->range_locked = true;
+  ctx->mm_is_locked = true;
+
+out:
+  mutex_unlock(&ctx->lock);
+  return ret;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+/* Returns whether an operation on mm has to lock it, i.e., it is not locked by VM_LOCK of this file */
+static int mm_needs_lock(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  return !ctx->mm_is_locked || ctx->range_locked || mm != ctx->locked_mm;
+}
+
+/* Returns whether an operation on the mm of pid has to lock it */
+static int needs_lock(pteditor_ctx_t* ctx, size_t pid) {
+  return mm_needs_lock(ctx, get_mm(ctx, pid));
+}
+
+/* Returns whether mm is locked by VM_LOCK_RANGE, i.e., only the locked range can be updated */
+static int is_range_locked(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  return ctx->mm_is_locked && ctx->range_locked && mm == ctx->locked_mm;
+}
+
+/* Returns whether the addresses first to last are not all within the locked range of a range-locked mm */
+static int outside_locked_range(pteditor_ctx_t* ctx, struct mm_struct* mm, unsigned long first, unsigned long last) {
+  return is_range_locked(ctx, mm) && (first < ctx->lock_start || last >= ctx->lock_end);
+}
+
+/*
+ * Called while holding the mmap lock before entries of a range-locked mm are written, waits until
+ * running changes of the range's mappings are done and keeps further changes from starting until range_leave.
+ * Returns whether the range was entered.
+ */
+static int range_enter(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  if(!is_range_locked(ctx, mm)) return 0;
+  spin_lock(&ctx->range_lock);
+  while(ctx->range_invalidations) {
+    spin_unlock(&ctx->range_lock);
+    wait_event(ctx->range_wait, !READ_ONCE(ctx->range_invalidations));
+    spin_lock(&ctx->range_lock);
+  }
+  ctx->range_updates++;
+  spin_unlock(&ctx->range_lock);
+  return 1;
+}
+
+static void range_leave(pteditor_ctx_t* ctx, int entered) {
+  if(entered <= 0) return;
+  spin_lock(&ctx->range_lock);
+  ctx->range_updates--;
+  spin_unlock(&ctx->range_lock);
+  wake_up(&ctx->range_wait);
+}
+
+/* Called before entries of a mm are resolved, records the invalidation sequence if the mm is range-locked */
+static void range_resolve(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  if(is_range_locked(ctx, mm)) WRITE_ONCE(ctx->range_resolved_seq, smp_load_acquire(&ctx->range_seq));
+}
+
+/*
+ * Like range_enter, for writing entries that user space built from a resolve. Fails with -EAGAIN if
+ * the mappings of the range changed since the last resolve, as the entries might be stale.
+ */
+static int range_enter_resolved(pteditor_ctx_t* ctx, struct mm_struct* mm) {
+  int entered = range_enter(ctx, mm);
+
+  /* No change of the range can start while it is entered */
+  if(entered && READ_ONCE(ctx->range_seq) != READ_ONCE(ctx->range_resolved_seq)) {
+    range_leave(ctx, entered);
+    return -EAGAIN;
+  }
+  return entered;
+}
+
+static void* alloc_buffer(size_t size) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+  return kvmalloc(size, GFP_KERNEL);
+#else
+  return vmalloc(size);
+#endif
+}
+
+/*
+ * While a transaction is open, TLB invalidations are only recorded. On commit,
+ * the ranges are sorted and merged, and all mms are flushed with one shootdown.
+ */
+static int txn_range_cmp(const void* a, const void* b) {
+  const txn_range_t *ra = a, *rb = b;
+  if(ra->mm != rb->mm) return (ra->mm < rb->mm) ? -1 : 1;
+  if(ra->start != rb->start) return (ra->start < rb->start) ? -1 : 1;
+  return 0;
+}
+
+/* Sorts the recorded ranges and merges overlapping or adjacent ones, the caller holds txn_lock */
+static void txn_merge(pteditor_ctx_t* ctx) {
+  size_t i, merged = 0;
+
+  if(!ctx->txn.count) return;
+  sort(ctx->txn.ranges, ctx->txn.count, sizeof(txn_range_t), txn_range_cmp, NULL);
+  for(i = 1; i < ctx->txn.count; i++) {
+    txn_range_t *last = &ctx->txn.ranges[merged], *range = &ctx->txn.ranges[i];
+    if(range->mm == last->mm && range->start <= last->end) {
+      last->end = max(last->end, range->end);
+      mmdrop(range->mm);
+    } else {
+      ctx->txn.ranges[++merged] = *range;
+    }
+  }
+  ctx->txn.count = merged + 1;
+}
+
+/* Records an invalidation if a transaction is open, returns 0 if the caller has to flush */
+static int txn_record(pteditor_ctx_t* ctx, struct mm_struct* mm, unsigned long start, unsigned long end) {
+  int recorded = 0;
+
+  mutex_lock(&ctx->txn_lock);
+  if(ctx->txn.active && mm) {
+    if(ctx->txn.count == PTEDITOR_TXN_RANGES) txn_merge(ctx);
+    /* If the ranges cannot be merged, this invalidation is not deferred */
+    if(ctx->txn.count < PTEDITOR_TXN_RANGES) {
+      mmgrab(mm);
+      ctx->txn.ranges[ctx->txn.count].mm = mm;
+      ctx->txn.ranges[ctx->txn.count].start = start;
+      ctx->txn.ranges[ctx->txn.count].end = end;
+      ctx->txn.count++;
+      ctx->txn.requested++;
+      recorded = 1;
+    }
+  }
+  mutex_unlock(&ctx->txn_lock);
+  return recorded;
+}
+
+static int txn_begin(pteditor_ctx_t* ctx) {
+  int ret = 0;
+
+  mutex_lock(&ctx->txn_lock);
+  if(ctx->txn.active) {
+    ret = -EBUSY;
+  } else {
+    ctx->txn.active = true;
+    ctx->txn.count = 0;
+    ctx->txn.requested = 0;
+  }
+  mutex_unlock(&ctx->txn_lock);
+  return ret;
+}
+
+/* Closes the transaction and issues one shootdown for all recorded mms (one per mm if that is not possible) */
+static int txn_commit(pteditor_ctx_t* ctx, ptedit_txn_t* result) {
+  txn_range_t* ranges;
+  size_t i, first, count;
+
+  mutex_lock(&ctx->txn_lock);
+  if(!ctx->txn.active) {
+    mutex_unlock(&ctx->txn_lock);
+    return -EINVAL;
+  }
+  txn_merge(ctx);
+  count = ctx->txn.count;
+  ranges = alloc_buffer(max_t(size_t, count, 1) * sizeof(txn_range_t));
+  if(!ranges) {
+    mutex_unlock(&ctx->txn_lock);
+    return -ENOMEM;
+  }
+  memcpy(ranges, ctx->txn.ranges, count * sizeof(txn_range_t));
+  ctx->txn.count = 0;
+  ctx->txn.active = false;
+  result->requested = ctx->txn.requested;
+  mutex_unlock(&ctx->txn_lock);
+
+  /* Flush without holding txn_lock, as updates take it while holding the mm lock */
+  result->issued = 0;
+  /* With the kernel invalidation, the shootdown flushes every process once (one IPI round per process on x86) */
+  if(ctx->invalidate_tlb_range == invalidate_tlb_range_kernel && count) {
+    result->issued = shootdown(ranges, count);
+  } else {
+    for(first = 0; first < count; first = i) {
+      struct mm_struct* mm = ranges[first].mm;
+      int lock = mm_needs_lock(ctx, mm);
+      for(i = first + 1; i < count && ranges[i].mm == mm; i++);
+      /* A single ranged flush over all ranges of the mm, it covers the entire mm if the span is large */
+      if(lock) lock_mm_read(mm);
+      ctx->invalidate_tlb_range(mm, ranges[first].start, ranges[i - 1].end);
+      if(lock) unlock_mm_read(mm);
+      result->issued++;
+    }
+  }
+  for(i = 0; i < count; i++) {
+    mmdrop(ranges[i].mm);
+  }
+  kvfree(ranges);
+  return 0;
+}
+
+static void txn_invalidate_tlb(pteditor_ctx_t* ctx, size_t pid, void* addr) {
+  unsigned long start = (unsigned long)addr & PAGE_MASK;
+  struct mm_struct* mm = get_mm(ctx, pid);
+  if(!ctx->txn.active || !mm || !txn_record(ctx, mm, start, start + PAGE_SIZE)) {
+    ctx->invalidate_tlb(mm, addr);
+  }
+}
+
+static void txn_invalidate_tlb_range(pteditor_ctx_t* ctx, struct mm_struct* mm, unsigned long start, unsigned long end) {
+  if(!ctx->txn.active || !txn_record(ctx, mm, start, end)) {
+    ctx->invalidate_tlb_range(mm, start, end);
+  }
+}
+
+/* Invalidates ranges of multiple processes with one shootdown, or records them if a transaction is open */
+static long shootdown_user(pteditor_ctx_t* ctx, ptedit_shootdown_t* args) {
+  ptedit_shootdown_range_t* user;
+  txn_range_t* ranges;
+  struct mm_struct* mm;
+  unsigned long start, end;
+  size_t i, count = 0;
+  long ret = 0;
+
+  if(!args->count) return 0;
+  if(args->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+  user = alloc_buffer(args->count * sizeof(ptedit_shootdown_range_t));
+  ranges = alloc_buffer(args->count * sizeof(txn_range_t));
+  if(!user || !ranges) {
+    ret = -ENOMEM;
+    goto out;
+  }
+  if(from_user(user, args->ranges, args->count * sizeof(ptedit_shootdown_range_t))) {
+    ret = -EFAULT;
+    goto out;
+  }
+
+  for(i = 0; i < args->count; i++) {
+    mm = get_mm(ctx, user[i].pid);
+    if(!mm) {
+      ret = -ESRCH;
+      goto out;
+    }
+    start = user[i].start & PAGE_MASK;
+    end = PAGE_ALIGN(user[i].end);
+    if(!end) end = ULONG_MAX;
+    if(end <= start || txn_record(ctx, mm, start, end)) continue;
+    mmgrab(mm);
+    ranges[count].mm = mm;
+    ranges[count].start = start;
+    ranges[count].end = end;
+    count++;
+  }
+  sort(ranges, count, sizeof(txn_range_t), txn_range_cmp, NULL);
+  if(count && shootdown(ranges, count) < 0) {
+    /* Fall back to one flush per range */
+    for(i = 0; i < count; i++) {
+      int lock = mm_needs_lock(ctx, ranges[i].mm);
+      if(lock) lock_mm_read(ranges[i].mm);
+      ctx->invalidate_tlb_range(ranges[i].mm, ranges[i].start, ranges[i].end);
+      if(lock) unlock_mm_read(ranges[i].mm);
+    }
+  }
+
+out:
+  for(i = 0; i < count; i++) {
+    mmdrop(ranges[i].mm);
+  }
+  kvfree(user);
+  kvfree(ranges);
+  return ret;
+}
+
+static void clear_vm(vm_t* entry) {
+  entry->pud = NULL;
+  entry->pmd = NULL;
+  entry->pgd = NULL;
+  entry->pte = NULL;
+  entry->p4d = NULL;
+  entry->valid = 0;
+}
+
+/*
+ * Locks the page table the PMD points to and returns the PTE of addr, or NULL if the PMD does not (or no longer)
+ * point to a page table. Since 6.5, page tables can be freed without the mmap lock (e.g., by khugepaged, deferred
+ * by RCU), hence, the PMD is rechecked under the lock, and the RCU read lock is held until unlock_pte.
+ */
+static pte_t* lock_pte(struct mm_struct* mm, pmd_t* pmd, unsigned long addr, spinlock_t** ptl) {
+  pmd_t pmdval;
+
+  rcu_read_lock();
+  pmdval = READ_ONCE(*pmd);
+  if(pmd_none(pmdval) || !pmd_present(pmdval) || pmd_leaf(pmdval)) goto fail;
+  *ptl = pte_lockptr(mm, &pmdval);
+  spin_lock(*ptl);
+  if(pmd_same(pmdval, READ_ONCE(*pmd))) return pte_offset_kernel(pmd, addr);
+  spin_unlock(*ptl);
+fail:
+  rcu_read_unlock();
+  return NULL;
+}
+
+static void unlock_pte(spinlock_t* ptl) {
+  spin_unlock(ptl);
+  rcu_read_unlock();
+}
+
+/* Walks the page tables of mm, the caller is responsible for locking mm */
+static int resolve_vm_mm(struct mm_struct* mm, size_t addr, vm_t* entry) {
+  clear_vm(entry);
+
+  /* Return PGD (page global directory) entry */
+  entry->pgd = pgd_offset(mm, addr);
+  if (pgd_none(*(entry->pgd)) || pgd_bad(*(entry->pgd))) {
+      entry->pgd = NULL;
+      return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PGD;
+
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  /* Return p4d offset */
+  entry->p4d = p4d_offset(entry->pgd, addr);
+  if (p4d_none(*(entry->p4d)) || p4d_bad(*(entry->p4d))) {
+    entry->p4d = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_P4D;
+
+  /* Get offset of PUD (page upper directory) */
+  entry->pud = pud_offset(entry->p4d, addr);
+  if (pud_none(*(entry->pud))) {
+    entry->pud = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PUD;
+#else
+  /* Get offset of PUD (page upper directory) */
+  entry->pud = pud_offset(entry->pgd, addr);
+  if (pud_none(*(entry->pud))) {
+    entry->pud = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PUD;
+#endif
+
+
+  /* Get offset of PMD (page middle directory) */
+  entry->pmd = pmd_offset(entry->pud, addr);
+  if (pmd_none(*(entry->pmd)) || pud_leaf(*(entry->pud))) {
+    entry->pmd = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PMD;
+
+  /* Map PTE (page table entry) */
+  entry->pte = map_pte(entry->pmd, addr);
+  if (entry->pte == NULL || pmd_leaf(*(entry->pmd))) {
+    entry->pte = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PTE;
+
+  /* Unmap PTE, fine on x86 and ARM64 -> unmap is NOP */
+  unmap_pte(entry->pte);
+
+  return 0;
+}
+
+/*
+ * Walks the page tables of a virtual address range, descending only once per
+ * upper-level entry. The entry callback is called with the resolved entries for
+ * every page, or once for a whole region that is unmapped or mapped by a huge
+ * page. The optional descend callback is called before descending from an
+ * upper-level entry (level is one of PTEDIT_VALID_MASK_*), the region is
+ * skipped without calling entry if it returns 0. The caller is responsible for
+ * locking mm. Leaf entries are visited while holding the lock of their page
+ * table, i.e., entry must not sleep. The optional unlock callback is called
+ * before that lock is released. A page table that is replaced underneath
+ * (e.g., collapsed to a huge page) is visited as a hole at the PMD level.
+ */
+typedef struct range_walk_s {
+  void (*entry)(struct range_walk_s* walk, vm_t* vm, unsigned long addr, unsigned long next);
+  int (*descend)(struct range_walk_s* walk, vm_t* vm, size_t level, unsigned long addr, unsigned long next);
+  void (*unlock)(struct range_walk_s* walk);
+  void* private;
+  struct mm_struct* mm;
+} range_walk_t;
+
+static int walk_descend(range_walk_t* walk, vm_t* vm, size_t level, unsigned long addr, unsigned long next) {
+  return !walk->descend || walk->descend(walk, vm, level, addr, next);
+}
+
+static void walk_range_pte(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long end) {
+  spinlock_t *ptl;
+  pte_t *pte = lock_pte(walk->mm, vm->pmd, addr, &ptl);
+  if(!pte) {
+    pmd_t* pmd = vm->pmd;
+    vm->pmd = NULL;
+    vm->valid &= ~PTEDIT_VALID_MASK_PMD;
+    walk->entry(walk, vm, addr, end);
+    vm->pmd = pmd;
+    vm->valid |= PTEDIT_VALID_MASK_PMD;
+    return;
+  }
+  vm->valid |= PTEDIT_VALID_MASK_PTE;
+  for(vm->pte = pte; addr != end; addr += PAGE_SIZE, vm->pte++) {
+    walk->entry(walk, vm, addr, addr + PAGE_SIZE);
+  }
+  if(walk->unlock) walk->unlock(walk);
+  unlock_pte(ptl);
+  vm->pte = NULL;
+  vm->valid &= ~PTEDIT_VALID_MASK_PTE;
+}
+
+/* Visits a huge PMD under the PMD lock, returns 0 if it was split in the meantime */
+static int walk_range_huge_pmd(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long next) {
+  spinlock_t *ptl = pmd_lock(walk->mm, vm->pmd);
+  int leaf = pmd_leaf(*vm->pmd);
+  if(leaf) walk->entry(walk, vm, addr, next);
+  if(leaf && walk->unlock) walk->unlock(walk);
+  spin_unlock(ptl);
+  return leaf;
+}
+
+static void walk_range_pmd(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long end) {
+  pmd_t *pmd = pmd_offset(vm->pud, addr);
+  unsigned long next;
+  do {
+    next = pmd_addr_end(addr, end);
+    if(pmd_none(*pmd)) {
+      walk->entry(walk, vm, addr, next);
+      continue;
+    }
+    vm->pmd = pmd;
+    vm->valid |= PTEDIT_VALID_MASK_PMD;
+    if(!pmd_leaf(*pmd) || !walk_range_huge_pmd(walk, vm, addr, next)) {
+      if(walk_descend(walk, vm, PTEDIT_VALID_MASK_PMD, addr, next)) walk_range_pte(walk, vm, addr, next);
+    }
+    vm->pmd = NULL;
+    vm->valid &= ~PTEDIT_VALID_MASK_PMD;
+  } while(pmd++, addr = next, addr != end);
+}
+
+static void walk_range_pud(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long end) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  pud_t *pud = pud_offset(vm->p4d, addr);
+#else
+  pud_t *pud = pud_offset(vm->pgd, addr);
+#endif
+  unsigned long next;
+  do {
+    next = pud_addr_end(addr, end);
+    if(pud_none(*pud)) {
+      walk->entry(walk, vm, addr, next);
+      continue;
+    }
+    vm->pud = pud;
+    vm->valid |= PTEDIT_VALID_MASK_PUD;
+    if(pud_leaf(*pud)) {
+      /* Huge PUDs are written under page_table_lock (see update_vm_mm) */
+      spin_lock(&walk->mm->page_table_lock);
+      walk->entry(walk, vm, addr, next);
+      if(walk->unlock) walk->unlock(walk);
+      spin_unlock(&walk->mm->page_table_lock);
+    } else if(walk_descend(walk, vm, PTEDIT_VALID_MASK_PUD, addr, next)) {
+      walk_range_pmd(walk, vm, addr, next);
+    }
+    vm->pud = NULL;
+    vm->valid &= ~PTEDIT_VALID_MASK_PUD;
+  } while(pud++, addr = next, addr != end);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+static void walk_range_p4d(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long end) {
+  p4d_t *p4d = p4d_offset(vm->pgd, addr);
+  unsigned long next;
+  do {
+    next = p4d_addr_end(addr, end);
+    if(p4d_none(*p4d) || p4d_bad(*p4d)) {
+      walk->entry(walk, vm, addr, next);
+      continue;
+    }
+    vm->p4d = p4d;
+    vm->valid |= PTEDIT_VALID_MASK_P4D;
+    if(walk_descend(walk, vm, PTEDIT_VALID_MASK_P4D, addr, next)) walk_range_pud(walk, vm, addr, next);
+    vm->p4d = NULL;
+    vm->valid &= ~PTEDIT_VALID_MASK_P4D;
+  } while(p4d++, addr = next, addr != end);
+}
+#endif
+
+static void walk_range(struct mm_struct* mm, unsigned long addr, unsigned long end, range_walk_t* walk) {
+  pgd_t *pgd = pgd_offset(mm, addr);
+  unsigned long next;
+  vm_t vm;
+
+  walk->mm = mm;
+  clear_vm(&vm);
+  do {
+    next = pgd_addr_end(addr, end);
+    if(pgd_none(*pgd) || pgd_bad(*pgd)) {
+      walk->entry(walk, &vm, addr, next);
+      continue;
+    }
+    vm.pgd = pgd;
+    vm.valid |= PTEDIT_VALID_MASK_PGD;
+    if(walk_descend(walk, &vm, PTEDIT_VALID_MASK_PGD, addr, next)) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+      walk_range_p4d(walk, &vm, addr, next);
+#else
+      walk_range_pud(walk, &vm, addr, next);
+#endif
+    }
+    vm.pgd = NULL;
+    vm.valid &= ~PTEDIT_VALID_MASK_PGD;
+  } while(pgd++, addr = next, addr != end);
+}
+
+/*
+ * Updates the entries of one address, the caller is responsible for locking mm (for reading) and flushing the TLB.
+ * Every entry is written under the split page-table lock of its level, so updates of disjoint page tables run in parallel.
+ * The entries are written bottom-up, such that the PTE is written under the lock of the page table the old PMD points to.
+ * Returns the levels (PTEDIT_VALID_MASK_*) that were written, i.e., requested levels that exist.
+ */
+static int update_vm_mm(struct mm_struct* mm, ptedit_entry_t* new_entry, pid_t tgid) {
+  vm_t old_entry;
+  size_t addr = new_entry->vaddr;
+  spinlock_t *lock;
+  pte_t *pte;
+  int written = 0;
+
+  old_entry.pid = new_entry->pid;
+  resolve_vm_mm(mm, addr, &old_entry);
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PTE) && (new_entry->valid & PTEDIT_VALID_MASK_PTE)) {
+      pte = lock_pte(mm, old_entry.pmd, addr, &lock);
+      if(pte) {
+        trace_pteditor_update(mm, tgid, addr, PTEDIT_VALID_MASK_PTE, pte_val(*pte), new_entry->pte);
+        set_pte(pte, native_make_pte(new_entry->pte));
+        unlock_pte(lock);
+        written |= PTEDIT_VALID_MASK_PTE;
+      }
+  }
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PMD) && (new_entry->valid & PTEDIT_VALID_MASK_PMD)) {
+      lock = pmd_lock(mm, old_entry.pmd);
+      trace_pteditor_update(mm, tgid, addr, PTEDIT_VALID_MASK_PMD, pmd_val(*old_entry.pmd), new_entry->pmd);
+      set_pmd(old_entry.pmd, native_make_pmd(new_entry->pmd));
+      spin_unlock(lock);
+      written |= PTEDIT_VALID_MASK_PMD;
+  }
+
+  /* All levels above the PMD are protected by the page_table_lock */
+  spin_lock(&mm->page_table_lock);
+  if((old_entry.valid & PTEDIT_VALID_MASK_PUD) && (new_entry->valid & PTEDIT_VALID_MASK_PUD)) {
+      trace_pteditor_update(mm, tgid, addr, PTEDIT_VALID_MASK_PUD, pud_val(*old_entry.pud), new_entry->pud);
+      set_pud(old_entry.pud, native_make_pud(new_entry->pud));
+      written |= PTEDIT_VALID_MASK_PUD;
+  }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  if((old_entry.valid & PTEDIT_VALID_MASK_P4D) && (new_entry->valid & PTEDIT_VALID_MASK_P4D)) {
+      trace_pteditor_update(mm, tgid, addr, PTEDIT_VALID_MASK_P4D, p4d_val(*old_entry.p4d), new_entry->p4d);
+      set_p4d(old_entry.p4d, native_make_p4d(new_entry->p4d));
+      written |= PTEDIT_VALID_MASK_P4D;
+  }
+#endif
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PGD) && (new_entry->valid & PTEDIT_VALID_MASK_PGD)) {
+      trace_pteditor_update(mm, tgid, addr, PTEDIT_VALID_MASK_PGD, pgd_val(*old_entry.pgd), new_entry->pgd);
+      set_pgd(old_entry.pgd, native_make_pgd(new_entry->pgd));
+      written |= PTEDIT_VALID_MASK_PGD;
+  }
+  spin_unlock(&mm->page_table_lock);
+
+  return written;
+}
+
+static int update_vm(pteditor_ctx_t* ctx, ptedit_entry_t* new_entry, int lock) {
+  size_t addr = new_entry->vaddr;
+  struct mm_struct *mm = get_mm(ctx, new_entry->pid);
+  int entered;
+  if(!mm) return 1;
+
+  /* Only the locked range of a range-locked mm can be updated */
+  if(outside_locked_range(ctx, mm, addr, addr)) return -ERANGE;
+
+  /* Lock mm, the read lock only keeps the page tables alive */
+  if(lock) lock_mm_read(mm);
+  entered = range_enter_resolved(ctx, mm);
+  if(entered < 0) {
+    if(lock) unlock_mm_read(mm);
+    return entered;
+  }
+
+  update_vm_mm(mm, new_entry, trace_tgid(ctx, new_entry->pid));
+
+  txn_invalidate_tlb(ctx, new_entry->pid, (void*) addr);
+
+  /* Unlock mm */
+  range_leave(ctx, entered);
+  if(lock) unlock_mm_read(mm);
+
+  return 0;
+}
+
+static int update_vm_batch(pteditor_ctx_t* ctx, ptedit_update_batch_t* batch, int lock) {
+  struct mm_struct *mm;
+  ptedit_entry_t *entries;
+  unsigned long start = ULONG_MAX, end = 0;
+  size_t i;
+  int ret = 0, entered;
+  pid_t tgid;
+
+  if(batch->count == 0) return 0;
+  if(batch->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+
+  mm = get_mm(ctx, batch->pid);
+  if(!mm) return -ESRCH;
+
+  entries = alloc_buffer(batch->count * sizeof(ptedit_entry_t));
+  if(!entries) return -ENOMEM;
+  if(from_user(entries, batch->entries, batch->count * sizeof(ptedit_entry_t))) {
+    ret = -EFAULT;
+    goto out;
+  }
+  /* Only the locked range of a range-locked mm can be updated */
+  for(i = 0; i < batch->count; i++) {
+    if(outside_locked_range(ctx, mm, entries[i].vaddr, entries[i].vaddr)) {
+      ret = -ERANGE;
+      goto out;
+    }
+  }
+
+  tgid = trace_tgid(ctx, batch->pid);
+  if(lock) lock_mm_read(mm);
+  entered = range_enter_resolved(ctx, mm);
+  if(entered < 0) {
+    if(lock) unlock_mm_read(mm);
+    ret = entered;
+    goto out;
+  }
+
+  for(i = 0; i < batch->count; i++) {
+    entries[i].pid = batch->pid;
+    update_vm_mm(mm, &entries[i], tgid);
+    start = min(start, (unsigned long)entries[i].vaddr & PAGE_MASK);
+    end = max(end, ((unsigned long)entries[i].vaddr & PAGE_MASK) + PAGE_SIZE);
+  }
+
+  /* A single shootdown covering all updated addresses */
+  txn_invalidate_tlb_range(ctx, mm, start, end);
+
+  range_leave(ctx, entered);
+  if(lock) unlock_mm_read(mm);
+
+out:
+  kvfree(entries);
+  return ret;
+}
+
+
+static void vm_to_user(ptedit_entry_t* user, vm_t* vm) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#if CONFIG_PGTABLE_LEVELS > 4
+    if(vm->p4d) user->p4d = READ_ONCE((vm->p4d)->p4d);
+#else
+#if !defined(__ARCH_HAS_5LEVEL_HACK)
+    if(vm->p4d) user->p4d = READ_ONCE((vm->p4d)->pgd.pgd);
+#else
+    if(vm->p4d) user->p4d = READ_ONCE((vm->p4d)->pgd);
+#endif
+#endif
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+    if(vm->pgd) user->pgd = READ_ONCE((vm->pgd)->pgd);
+    if(vm->pmd) user->pmd = READ_ONCE((vm->pmd)->pmd);
+    if(vm->pud) user->pud = READ_ONCE((vm->pud)->pud);
+    if(vm->pte) user->pte = READ_ONCE((vm->pte)->pte);
+#elif defined(__aarch64__)
+    if(vm->pgd) user->pgd = pgd_val(READ_ONCE(*(vm->pgd)));
+    if(vm->pmd) user->pmd = pmd_val(READ_ONCE(*(vm->pmd)));
+    if(vm->pud) user->pud = pud_val(READ_ONCE(*(vm->pud)));
+    if(vm->pte) user->pte = pte_val(READ_ONCE(*(vm->pte)));
+#endif
+    user->valid = vm->valid;
+}
+
+
+/*
+ * Copies the entries of addr. Since 6.5, PTE tables are also freed without the mmap lock (retract_page_tables
+ * defers freeing by RCU), hence, they are only read within an RCU read-side critical section.
+ */
+static void resolve_vm_copy(struct mm_struct* mm, size_t addr, ptedit_entry_t* entry) {
+  vm_t vm;
+
+  rcu_read_lock();
+  vm.pid = entry->pid;
+  resolve_vm_mm(mm, addr, &vm);
+  vm_to_user(entry, &vm);
+  rcu_read_unlock();
+}
+
+/*
+ * Resolves the address of entry without taking the mmap lock if possible, returns the
+ * path (PTEDITOR_RESOLVE_PATH_*) that served the request. The entries are copied
+ * while the page tables are protected, no pointers into them are returned.
+ */
+static int resolve_vm(pteditor_ctx_t* ctx, ptedit_entry_t* entry, int lock) {
+  struct mm_struct *mm;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0) && defined(CONFIG_PER_VMA_LOCK)
+  struct vm_area_struct *vma;
+#endif
+  size_t addr = entry->vaddr;
+  unsigned long flags;
+
+  entry->valid = 0;
+  mm = get_mm(ctx, entry->pid);
+  if(!mm) {
+      return -ESRCH;
+  }
+  range_resolve(ctx, mm);
+
+  /* The caller already holds the lock */
+  if(!lock) {
+    resolve_vm_copy(mm, addr, entry);
+    return PTEDITOR_RESOLVE_PATH_LOCKED;
+  }
+
+  /*
+   * Like GUP-fast, page tables of the own mm cannot be freed while interrupts
+   * are disabled, as freeing waits for the TLB shootdown IPI (or an RCU grace
+   * period) which includes this CPU.
+   */
+  if(mm == current->mm) {
+    local_irq_save(flags);
+    resolve_vm_copy(mm, addr, entry);
+    local_irq_restore(flags);
+    return PTEDITOR_RESOLVE_PATH_IRQ;
+  }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0) && defined(CONFIG_PER_VMA_LOCK)
+  /* The VMA lock keeps the upper page tables alive, the PTE table is protected by RCU */
+  vma = lock_vma_under_rcu_func ? lock_vma_under_rcu_func(mm, addr) : NULL;
+  if(vma) {
+    resolve_vm_copy(mm, addr, entry);
+    vma_end_read(vma);
+    return PTEDITOR_RESOLVE_PATH_VMA;
+  }
+#endif
+
+  /* Slow path, e.g., for addresses without VMA */
+  lock_mm_read(mm);
+  resolve_vm_copy(mm, addr, entry);
+  unlock_mm_read(mm);
+
+  return PTEDITOR_RESOLVE_PATH_LOCKED;
+}
+
+
+static int resolve_vm_batch(pteditor_ctx_t* ctx, ptedit_resolve_batch_t* batch, int lock) {
+  struct mm_struct *mm;
+  size_t *vaddrs;
+  ptedit_entry_t *entries;
+  size_t i;
+  int ret = 0;
+
+  if(batch->count == 0) return 0;
+  if(batch->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+
+  vaddrs = alloc_buffer(batch->count * sizeof(size_t));
+  entries = alloc_buffer(batch->count * sizeof(ptedit_entry_t));
+  if(!vaddrs || !entries) {
+    ret = -ENOMEM;
+    goto out;
+  }
+  if(from_user(vaddrs, batch->vaddrs, batch->count * sizeof(size_t))) {
+    ret = -EFAULT;
+    goto out;
+  }
+
+  /* Look up the mm once and hold the lock for the whole batch */
+  mm = get_mm(ctx, batch->pid);
+  if(!mm) {
+    ret = -ESRCH;
+    goto out;
+  }
+  range_resolve(ctx, mm);
+  if(lock) lock_mm_read(mm);
+
+  for(i = 0; i < batch->count; i++) {
+    memset(&entries[i], 0, sizeof(ptedit_entry_t));
+    entries[i].pid = batch->pid;
+    entries[i].vaddr = vaddrs[i];
+    resolve_vm_copy(mm, vaddrs[i], &entries[i]);
+    stats_walk(entries[i].valid);
+  }
+
+  if(lock) unlock_mm_read(mm);
+
+  /* Copy out only after unlocking, as the buffer might fault */
+  if(to_user(batch->entries, entries, batch->count * sizeof(ptedit_entry_t))) {
+    ret = -EFAULT;
+  }
+
+out:
+  kvfree(vaddrs);
+  kvfree(entries);
+  return ret;
+}
+
+
+typedef struct {
+  size_t pid;
+  unsigned long start;
+  ptedit_entry_t* entries;
+} resolve_range_t;
+
+static void resolve_range_entry(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long next) {
+  resolve_range_t* range = walk->private;
+  ptedit_entry_t entry;
+
+  memset(&entry, 0, sizeof(entry));
+  entry.pid = range->pid;
+  vm_to_user(&entry, vm);
+  for(; addr != next; addr += PAGE_SIZE) {
+    entry.vaddr = addr;
+    range->entries[(addr - range->start) >> PAGE_SHIFT] = entry;
+  }
+}
+
+static long resolve_vm_range(pteditor_ctx_t* ctx, ptedit_resolve_range_args_t* args, int lock) {
+  struct mm_struct *mm;
+  unsigned long start = args->vaddr & PAGE_MASK;
+  unsigned long end = PAGE_ALIGN(args->vaddr + args->length);
+  size_t count = (end - start) >> PAGE_SHIFT;
+  range_walk_t walk;
+  resolve_range_t range;
+  long ret = count;
+
+  if(end <= start) return (args->length == 0) ? 0 : -EINVAL;
+  if(count > PTEDITOR_BATCH_MAX) return -EINVAL;
+
+  mm = get_mm(ctx, args->pid);
+  if(!mm) return -ESRCH;
+
+  range.pid = args->pid;
+  range.start = start;
+  range.entries = alloc_buffer(count * sizeof(ptedit_entry_t));
+  if(!range.entries) return -ENOMEM;
+  walk.entry = resolve_range_entry;
+  walk.descend = NULL;
+  walk.unlock = NULL;
+  walk.private = &range;
+
+  range_resolve(ctx, mm);
+  if(lock) lock_mm_read(mm);
+  walk_range(mm, start, end, &walk);
+  if(lock) unlock_mm_read(mm);
+
+  if(to_user(args->entries, range.entries, count * sizeof(ptedit_entry_t))) {
+    ret = -EFAULT;
+  }
+  kvfree(range.entries);
+  return ret;
+}
+
+
+typedef struct {
+  size_t set_mask;
+  size_t clear_mask;
+  size_t flags;
+  long changed;
+  unsigned long start, end;
+} pte_modify_range_t;
+
+static void pte_modify_range_entry(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long next) {
+  pte_modify_range_t* modify = walk->private;
+  pteval_t old, new, prev;
+
+  /* Holes and huge pages are skipped, the PTE lock is held */
+  if(!vm->pte) return;
+  /* Unless requested, non-present entries are skipped, the bits of swap or migration entries have a different meaning */
+#if defined(__i386__) || defined(__x86_64__)
+  if(!(modify->flags & PTEDITOR_MODIFY_NON_PRESENT) && !(pte_flags(*vm->pte) & _PAGE_PRESENT)) return;
+#elif defined(__aarch64__)
+  if(!(modify->flags & PTEDITOR_MODIFY_NON_PRESENT) && !pte_valid(*vm->pte)) return;
+#endif
+
+  /* Concurrent hardware accessed/dirty updates must not be lost */
+  old = READ_ONCE(vm->pte->pte);
+  do {
+    new = (old & ~(pteval_t)modify->clear_mask) | (pteval_t)modify->set_mask;
+    if(new == old) return;
+    prev = old;
+    old = cmpxchg(&vm->pte->pte, prev, new);
+  } while(old != prev);
+
+  modify->changed++;
+  modify->start = min(modify->start, addr);
+  modify->end = max(modify->end, next);
+}
+
+/* Large ranges are modified under the read lock only, which allows rescheduling between page tables */
+static int pte_modify_range_descend(range_walk_t* walk, vm_t* vm, size_t level, unsigned long addr, unsigned long next) {
+  if(level == PTEDIT_VALID_MASK_PMD) cond_resched();
+  return 1;
+}
+
+static long pte_modify_range(pteditor_ctx_t* ctx, ptedit_pte_modify_range_t* args, int lock) {
+  struct mm_struct *mm;
+  unsigned long start = args->vaddr & PAGE_MASK;
+  unsigned long end = PAGE_ALIGN(args->vaddr + args->length);
+  range_walk_t walk;
+  pte_modify_range_t modify;
+  int entered;
+
+  if(end <= start) return (args->length == 0) ? 0 : -EINVAL;
+
+  mm = get_mm(ctx, args->pid);
+  if(!mm) return -ESRCH;
+  /* Only the locked range of a range-locked mm can be updated */
+  if(outside_locked_range(ctx, mm, start, end - 1)) return -ERANGE;
+
+  modify.set_mask = args->set_mask;
+  modify.clear_mask = args->clear_mask;
+  modify.flags = args->flags;
+  modify.changed = 0;
+  modify.start = ULONG_MAX;
+  modify.end = 0;
+  walk.entry = pte_modify_range_entry;
+  walk.descend = pte_modify_range_descend;
+  walk.unlock = NULL;
+  walk.private = &modify;
+
+  /* The entries are modified atomically, the read lock only keeps the page tables alive */
+  if(lock) lock_mm_read(mm);
+  entered = range_enter(ctx, mm);
+  walk_range(mm, start, end, &walk);
+  if(modify.changed) txn_invalidate_tlb_range(ctx, mm, modify.start, modify.end);
+  range_leave(ctx, entered);
+  if(lock) unlock_mm_read(mm);
+
+  return modify.changed;
+}
+
+
+typedef struct {
+  size_t flags;
+  unsigned long start;
+  unsigned char* accessed;
+  unsigned char* dirty;
+  long young;
+  unsigned long flush_start, flush_end;
+  /* Pages of the locked page table whose dirty bit was cleared */
+  unsigned long clean_start, clean_end;
+} harvest_t;
+
+#if defined(__i386__) || defined(__x86_64__)
+/*
+ * The accessed bit of an upper-level entry is set by the page walker whenever it walks through the entry.
+ * If it is clear, no page below was accessed since it was last cleared, i.e., since the last harvest of the range.
+ * With PTI, user mode walks a copy of the top-level entries (the user PGD), i.e., the accessed bits of the PGD
+ * (and of the P4D if it is folded into the PGD) are never set by user accesses, and these levels are not skipped.
+ */
+static int harvest_descend(range_walk_t* walk, vm_t* vm, size_t level, unsigned long addr, unsigned long next) {
+  harvest_t* harvest = walk->private;
+  unsigned long* entry;
+
+  if(!(harvest->flags & PTEDITOR_HARVEST_SKIP_OLD)) return 1;
+#if defined(X86_FEATURE_PTI)
+  if((level == PTEDIT_VALID_MASK_PGD || level == PTEDIT_VALID_MASK_P4D) && boot_cpu_has(X86_FEATURE_PTI)) return 1;
+#endif
+  switch(level) {
+    case PTEDIT_VALID_MASK_PGD: entry = (unsigned long*)vm->pgd; break;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+    case PTEDIT_VALID_MASK_P4D: entry = (unsigned long*)vm->p4d; break;
+#endif
+    case PTEDIT_VALID_MASK_PUD: entry = (unsigned long*)vm->pud; break;
+    case PTEDIT_VALID_MASK_PMD: entry = (unsigned long*)vm->pmd; break;
+    default: return 1;
+  }
+  if(!(READ_ONCE(*entry) & _PAGE_ACCESSED)) return 0;
+  /* Cleared before the entries below, an access in between sets it again */
+  if(harvest->flags & PTEDITOR_HARVEST_CLEAR_ACCESSED) {
+    clear_bit(_PAGE_BIT_ACCESSED, entry);
+    harvest->flush_start = min(harvest->flush_start, addr);
+    harvest->flush_end = max(harvest->flush_end, next);
+  }
+  return 1;
+}
+#endif
+
+static void harvest_mark_dirty(pte_t pte) {
+  struct page* page;
+
+  if(pte_special(pte) || !pfn_valid(pte_pfn(pte))) return;
+  page = pfn_to_page(pte_pfn(pte));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 16, 0)
+  folio_mark_dirty(page_folio(page));
+#else
+  set_page_dirty(page);
+#endif
+}
+
+/*
+ * Cleaned entries are flushed before the page-table lock is released. Otherwise, writeback could clean the
+ * folio (its rmap walk takes the lock) while a stale dirty TLB entry still allows writes that set no dirty bit.
+ */
+static void harvest_unlock(range_walk_t* walk) {
+  harvest_t* harvest = walk->private;
+  txn_range_t range;
+
+  if(harvest->clean_start >= harvest->clean_end) return;
+  range.mm = walk->mm;
+  range.start = harvest->clean_start;
+  range.end = harvest->clean_end;
+  shootdown(&range, 1);
+  harvest->clean_start = ULONG_MAX;
+  harvest->clean_end = 0;
+}
+
+static void harvest_entry(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long next) {
+  harvest_t* harvest = walk->private;
+  unsigned long *entry = NULL, old, new, prev;
+  unsigned long i;
+  int young, dirty;
+  pte_t pte;
+
+  if(vm->pte) entry = (unsigned long*)vm->pte;
+  else if(vm->pmd && pmd_leaf(*vm->pmd)) entry = (unsigned long*)vm->pmd;
+  else if(vm->pud && pud_leaf(*vm->pud)) entry = (unsigned long*)vm->pud;
+  if(!entry) return;
+
+  /* Huge leaves share the accessed and dirty bits with PTEs, concurrent hardware updates must not be lost */
+  old = READ_ONCE(*entry);
+  do {
+    pte = native_make_pte(old);
+    if(!pte_present(pte)) return;
+    young = pte_young(pte);
+    dirty = pte_dirty(pte);
+    if(harvest->flags & PTEDITOR_HARVEST_CLEAR_ACCESSED) pte = pte_mkold(pte);
+    if(harvest->flags & PTEDITOR_HARVEST_CLEAR_DIRTY) pte = pte_mkclean(pte);
+    new = pte_val(pte);
+    if(new == old) break;
+    prev = old;
+    old = cmpxchg(entry, prev, new);
+  } while(old != prev);
+
+  if(new != old) {
+    harvest->flush_start = min(harvest->flush_start, addr);
+    harvest->flush_end = max(harvest->flush_end, next);
+  }
+  /* The dirty state moves from the entry to the folio, writeback must not miss it */
+  if(dirty && !pte_dirty(pte)) {
+    harvest_mark_dirty(pte);
+    harvest->clean_start = min(harvest->clean_start, addr);
+    harvest->clean_end = max(harvest->clean_end, next);
+  }
+  for(; addr != next; addr += PAGE_SIZE) {
+    i = (addr - harvest->start) >> PAGE_SHIFT;
+    if(young) {
+      harvest->accessed[i / 8] |= 1 << (i % 8);
+      harvest->young++;
+    }
+    if(dirty) harvest->dirty[i / 8] |= 1 << (i % 8);
+  }
+}
+
+/* Collects the accessed and dirty bits of a range in chunks, returns the number of accessed pages */
+static long harvest_range(pteditor_ctx_t* ctx, ptedit_harvest_t* args, int lock) {
+  struct mm_struct *mm;
+  unsigned long start = args->vaddr & PAGE_MASK;
+  unsigned long end = PAGE_ALIGN(args->vaddr + args->length);
+  unsigned long addr, next;
+  size_t bytes, offset;
+  range_walk_t walk;
+  harvest_t harvest;
+  long ret = 0;
+  int entered;
+
+  if(end <= start) return (args->length == 0) ? 0 : -EINVAL;
+
+  mm = get_mm(ctx, args->pid);
+  if(!mm) return -ESRCH;
+  /* Clearing the bits updates the entries, which is only allowed in the locked range of a range-locked mm */
+  if((args->flags & (PTEDITOR_HARVEST_CLEAR_ACCESSED | PTEDITOR_HARVEST_CLEAR_DIRTY)) &&
+     outside_locked_range(ctx, mm, start, end - 1)) return -ERANGE;
+
+  harvest.accessed = alloc_buffer(2 * PTEDITOR_HARVEST_CHUNK / 8);
+  if(!harvest.accessed) return -ENOMEM;
+  harvest.dirty = harvest.accessed + PTEDITOR_HARVEST_CHUNK / 8;
+  harvest.flags = args->flags;
+  harvest.young = 0;
+  harvest.flush_start = harvest.clean_start = ULONG_MAX;
+  harvest.flush_end = harvest.clean_end = 0;
+  walk.entry = harvest_entry;
+#if defined(__i386__) || defined(__x86_64__)
+  walk.descend = harvest_descend;
+#else
+  walk.descend = NULL;
+#endif
+  walk.unlock = harvest_unlock;
+  walk.private = &harvest;
+
+  for(addr = start; addr < end; addr = next) {
+    next = (end - addr > PTEDITOR_HARVEST_CHUNK * PAGE_SIZE) ? addr + PTEDITOR_HARVEST_CHUNK * PAGE_SIZE : end;
+    bytes = DIV_ROUND_UP((next - addr) >> PAGE_SHIFT, 8);
+    offset = ((addr - start) >> PAGE_SHIFT) / 8;
+    memset(harvest.accessed, 0, 2 * PTEDITOR_HARVEST_CHUNK / 8);
+    harvest.start = addr;
+
+    /* The entries are modified atomically, the read lock only keeps the page tables alive */
+    if(lock) lock_mm_read(mm);
+    entered = range_enter(ctx, mm);
+    walk_range(mm, addr, next, &walk);
+    range_leave(ctx, entered);
+    if(lock) unlock_mm_read(mm);
+
+    /* Copy out only after unlocking, as the bitmaps might fault */
+    if((args->accessed && to_user(args->accessed + offset, harvest.accessed, bytes)) ||
+       (args->dirty && to_user(args->dirty + offset, harvest.dirty, bytes))) {
+      ret = -EFAULT;
+      break;
+    }
+  }
+
+  /* A single flush for all entries whose bits were cleared */
+  if(harvest.flush_start < harvest.flush_end) {
+    if(lock) lock_mm_read(mm);
+    txn_invalidate_tlb_range(ctx, mm, harvest.flush_start, harvest.flush_end);
+    if(lock) unlock_mm_read(mm);
+  }
+
+  kvfree(harvest.accessed);
+  return ret ? ret : harvest.young;
+}
+
+
+static long cmpxchg_vm(pteditor_ctx_t* ctx, ptedit_cmpxchg_t* args, int lock) {
+  struct mm_struct *mm;
+  unsigned long *entry, start, size;
+  spinlock_t *ptl;
+  vm_t vm;
+  long ret = 0;
+  int entered;
+
+  mm = get_mm(ctx, args->pid);
+  if(!mm) return -ESRCH;
+  /* Only the locked range of a range-locked mm can be updated */
+  if(outside_locked_range(ctx, mm, args->vaddr, args->vaddr)) return -ERANGE;
+
+  /* The entry is exchanged atomically, the read lock only keeps the page tables alive */
+  if(lock) lock_mm_read(mm);
+  entered = range_enter(ctx, mm);
+
+retry:
+  vm.pid = args->pid;
+  resolve_vm_mm(mm, args->vaddr, &vm);
+  switch(args->level) {
+    case PTEDIT_VALID_MASK_PGD: entry = (unsigned long*)vm.pgd; size = PGDIR_SIZE; break;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+    case PTEDIT_VALID_MASK_P4D: entry = (unsigned long*)vm.p4d; size = P4D_SIZE; break;
+#endif
+    case PTEDIT_VALID_MASK_PUD: entry = (unsigned long*)vm.pud; size = PUD_SIZE; break;
+    case PTEDIT_VALID_MASK_PMD: entry = (unsigned long*)vm.pmd; size = PMD_SIZE; break;
+    case PTEDIT_VALID_MASK_PTE: entry = (unsigned long*)vm.pte; size = PAGE_SIZE; break;
+    default: ret = -EINVAL; goto out;
+  }
+  if(!(vm.valid & args->level) || !entry) {
+    ret = -ENOENT;
+    goto out;
+  }
+
+  /* Every level is exchanged under the lock it is written with by update_vm_mm */
+  if(args->level == PTEDIT_VALID_MASK_PTE) {
+    entry = (unsigned long*)lock_pte(mm, vm.pmd, args->vaddr, &ptl);
+    /* The page table was freed or replaced since the walk */
+    if(!entry) goto retry;
+  } else if(args->level == PTEDIT_VALID_MASK_PMD) {
+    ptl = pmd_lock(mm, vm.pmd);
+  } else {
+    ptl = &mm->page_table_lock;
+    spin_lock(ptl);
+  }
+
+  args->observed = cmpxchg(entry, (unsigned long)args->expected, (unsigned long)args->desired);
+  if(args->observed == args->expected) {
+#if defined(__i386__) || defined(__x86_64__)
+    /* With PTI, top-level entries are mirrored to the user page table by set_pgd/set_p4d */
+    if(args->level == PTEDIT_VALID_MASK_PGD) set_pgd(vm.pgd, *vm.pgd);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+    if(args->level == PTEDIT_VALID_MASK_P4D) set_p4d(vm.p4d, *vm.p4d);
+#endif
+#endif
+  }
+  if(args->level == PTEDIT_VALID_MASK_PTE) unlock_pte(ptl);
+  else spin_unlock(ptl);
+  if(args->observed != args->expected) goto out;
+  trace_pteditor_update(mm, trace_tgid(ctx, args->pid), args->vaddr, args->level, args->observed, args->desired);
+
+  /* An upper-level entry translates everything below it */
+  start = args->vaddr & ~(size - 1);
+  txn_invalidate_tlb_range(ctx, mm, start, (start + size > start) ? start + size : ULONG_MAX);
+
+out:
+  range_leave(ctx, entered);
+  if(lock) unlock_mm_read(mm);
+  return ret;
+}
+
+/*
+ * Runs an operation repeatedly without leaving the kernel and sums up the cycles of each phase,
+ * such that the cost of the page walk can be told apart from the cost of the ioctl itself.
+ * The TLB is invalidated directly, even if a transaction is open.
+ */
+static long bench(pteditor_ctx_t* ctx, ptedit_bench_t* args) {
+  struct mm_struct* mm;
+  cycles_t t0, t1, t2, t3, t4, t5;
+  spinlock_t* ptl;
+  pteval_t old;
+  pte_t* pte;
+  vm_t vm;
+  size_t i;
+  int lock, entered;
+
+  if(args->op > PTEDITOR_BENCH_FLUSH) return -EINVAL;
+  mm = get_mm(ctx, args->pid);
+  if(!mm) return -ESRCH;
+  if(args->op == PTEDITOR_BENCH_UPDATE && outside_locked_range(ctx, mm, args->vaddr, args->vaddr)) return -ERANGE;
+  lock = needs_lock(ctx, args->pid);
+
+  args->lookup = args->lock = args->walk = args->flush = 0;
+  for(i = 0; i < args->iterations; i++) {
+    t0 = get_cycles();
+    mm = get_mm(ctx, args->pid);
+    t1 = get_cycles();
+    if(!mm) return -ESRCH;
+
+    if(lock) lock_mm_read(mm);
+    entered = args->op == PTEDITOR_BENCH_UPDATE && range_enter(ctx, mm);
+    t2 = get_cycles();
+
+    if(args->op != PTEDITOR_BENCH_FLUSH) {
+      vm.pid = args->pid;
+      resolve_vm_mm(mm, args->vaddr, &vm);
+      /* Written back under the PTE lock like update_vm_mm, but atomically, as accessed/dirty bits must not be lost */
+      if(args->op == PTEDITOR_BENCH_UPDATE && (vm.valid & PTEDIT_VALID_MASK_PTE)) {
+        pte = lock_pte(mm, vm.pmd, args->vaddr, &ptl);
+        if(pte) {
+          old = READ_ONCE(pte->pte);
+          (void)cmpxchg(&pte->pte, old, old);
+          unlock_pte(ptl);
+        }
+      }
+    }
+    t3 = get_cycles();
+
+    if(args->op != PTEDITOR_BENCH_RESOLVE) ctx->invalidate_tlb(mm, (void*)args->vaddr);
+    t4 = get_cycles();
+
+    range_leave(ctx, entered);
+    if(lock) unlock_mm_read(mm);
+    t5 = get_cycles();
+
+    args->lookup += t1 - t0;
+    args->lock += (t2 - t1) + (t5 - t4);
+    args->walk += t3 - t2;
+    args->flush += t4 - t3;
+
+    /* The number of iterations is not bounded, the benchmark can be interrupted */
+    if(fatal_signal_pending(current)) return -EINTR;
+    cond_resched();
+  }
+  return 0;
+}
+
+
+/* Copies one run of physically contiguous pages, the direct map is contiguous for them as well */
+static int copy_phys_run(ptedit_phys_iovec_t* run, int write) {
+  size_t i, size;
+  char* mem;
+
+  if(run->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+  for(i = 0; i < run->count; i++) {
+    if(!pfn_valid(run->pfn + i)) return -EINVAL;
+  }
+  mem = phys_to_virt(run->pfn * real_page_size);
+
+  /* Merged runs can span hundreds of MiB, they are copied in chunks that can be interrupted */
+  for(i = 0; i < run->count; i += PTEDITOR_PHYS_CHUNK) {
+    size = min_t(size_t, run->count - i, PTEDITOR_PHYS_CHUNK) * real_page_size;
+    if(write ? from_user(mem + i * real_page_size, run->buffer + i * real_page_size, size)
+             : to_user(run->buffer + i * real_page_size, mem + i * real_page_size, size)) return -EFAULT;
+    if(fatal_signal_pending(current)) return -EINTR;
+    cond_resched();
+  }
+  return 0;
+}
+
+/* Reads or writes runs of physical pages, returns the number of pages copied */
+static long copy_phys_batch(ptedit_phys_batch_t* batch, int write) {
+  ptedit_phys_iovec_t *iov, run;
+  size_t i, pages = 0;
+  long ret = 0;
+
+  if(batch->count == 0) return 0;
+  if(batch->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+
+  iov = alloc_buffer(batch->count * sizeof(ptedit_phys_iovec_t));
+  if(!iov) return -ENOMEM;
+  if(from_user(iov, batch->iov, batch->count * sizeof(ptedit_phys_iovec_t))) {
+    kvfree(iov);
+    return -EFAULT;
+  }
+
+  run = iov[0];
+  for(i = 1; i <= batch->count && !ret; i++) {
+    /* Merge runs that continue both in physical memory and in the buffer */
+    if(i < batch->count && iov[i].pfn == run.pfn + run.count &&
+       iov[i].buffer == run.buffer + run.count * real_page_size && run.count + iov[i].count <= PTEDITOR_BATCH_MAX) {
+      run.count += iov[i].count;
+      continue;
+    }
+    ret = copy_phys_run(&run, write);
+    if(!ret) pages += run.count;
+    if(i < batch->count) run = iov[i];
+    cond_resched();
+  }
+
+  kvfree(iov);
+  return ret ? ret : pages;
+}
+
+/* Copies, fills, or clears physical pages without moving their content through user space */
+static long phys_op(ptedit_phys_op_t* op, unsigned int cmd) {
+  size_t *dst, *src = NULL;
+  size_t i;
+  long ret = 0;
+
+  if(op->count == 0) return 0;
+  if(op->count > PTEDITOR_BATCH_MAX) return -EINVAL;
+
+  dst = alloc_buffer(op->count * sizeof(size_t));
+  if(cmd == PTEDITOR_IOCTL_CMD_COPY_PAGES) src = alloc_buffer(op->count * sizeof(size_t));
+  if(!dst || (cmd == PTEDITOR_IOCTL_CMD_COPY_PAGES && !src)) {
+    ret = -ENOMEM;
+    goto out;
+  }
+  if(from_user(dst, op->dst, op->count * sizeof(size_t)) ||
+     (src && from_user(src, op->src, op->count * sizeof(size_t)))) {
+    ret = -EFAULT;
+    goto out;
+  }
+  /* Validate all pages first, a batch is either executed entirely or not at all */
+  for(i = 0; i < op->count; i++) {
+    if(!pfn_valid(dst[i]) || (src && !pfn_valid(src[i]))) {
+      ret = -EINVAL;
+      goto out;
+    }
+  }
+
+  for(i = 0; i < op->count; i++) {
+    void* page = phys_to_virt(dst[i] * real_page_size);
+    if(cmd == PTEDITOR_IOCTL_CMD_COPY_PAGES) {
+      copy_page(page, phys_to_virt(src[i] * real_page_size));
+    } else if(cmd == PTEDITOR_IOCTL_CMD_FILL_PAGES) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 17, 0)
+      memset64(page, op->pattern, real_page_size / sizeof(u64));
+#else
+      size_t j;
+      for(j = 0; j < real_page_size / sizeof(u64); j++) ((u64*)page)[j] = op->pattern;
+#endif
+    } else {
+      clear_page(page);
+    }
+    if((i & 255) == 255) cond_resched();
+  }
+  ret = op->count;
+
+out:
+  kvfree(src);
+  kvfree(dst);
+  return ret;
+}
+
+/*
+ * Page-table dump, a file that streams one record per present entry of a process. The tables are
+ * walked in chunks whenever the buffer was read entirely, the cursor is the address to continue at.
+ */
+typedef struct {
+  struct mutex lock;
+  struct mm_struct* mm;
+  unsigned long cursor, end;
+  size_t len, off;
+  unsigned char buffer[PTEDITOR_DUMP_BUFFER];
+} pt_dump_t;
+
+static void dump_record(pt_dump_t* dump, unsigned long addr, size_t entry, size_t level) {
+  ptedit_dump_record_t record;
+  record.vaddr = addr;
+  record.entry = entry;
+  record.level = level;
+  memcpy(dump->buffer + dump->len, &record, sizeof(record));
+  dump->len += sizeof(record);
+}
+
+/*
+ * Returns whether the buffer cannot hold an entry of a level, all entries of the levels below it down to one
+ * page table. Stopping only at the start of an entry (if it does not fit) guarantees that no entry is dumped twice.
+ */
+static bool dump_full(pt_dump_t* dump, int levels) {
+  return dump->len + (PTRS_PER_PTE + levels) * sizeof(ptedit_dump_record_t) > PTEDITOR_DUMP_BUFFER;
+}
+
+static void dump_pte(pt_dump_t* dump, pmd_t* pmd, unsigned long addr, unsigned long end) {
+  pte_t *pte = map_pte(pmd, addr), *first = pte;
+  if(!pte) return;
+  for(; addr != end; addr += PAGE_SIZE, pte++) {
+    if(pte_present(*pte)) dump_record(dump, addr, pte_val(*pte), PTEDIT_VALID_MASK_PTE);
+  }
+  unmap_pte(first);
+}
+
+static unsigned long dump_pmd(pt_dump_t* dump, pud_t* pud, unsigned long addr, unsigned long end) {
+  pmd_t *pmd = pmd_offset(pud, addr);
+  unsigned long next;
+  do {
+    next = pmd_addr_end(addr, end);
+    if(pmd_none(*pmd)) continue;
+    if(dump_full(dump, 1)) return addr;
+    if(PTRS_PER_PMD > 1 && IS_ALIGNED(addr, PMD_SIZE)) dump_record(dump, addr, pmd_val(*pmd), PTEDIT_VALID_MASK_PMD);
+    if(!pmd_leaf(*pmd)) dump_pte(dump, pmd, addr, next);
+  } while(pmd++, addr = next, addr != end);
+  return end;
+}
+
+static unsigned long dump_pud(pt_dump_t* dump, vm_t* vm, unsigned long addr, unsigned long end) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  pud_t *pud = pud_offset(vm->p4d, addr);
+#else
+  pud_t *pud = pud_offset(vm->pgd, addr);
+#endif
+  unsigned long next, stop;
+  do {
+    next = pud_addr_end(addr, end);
+    if(pud_none(*pud)) continue;
+    if(dump_full(dump, 2)) return addr;
+    if(PTRS_PER_PUD > 1 && IS_ALIGNED(addr, PUD_SIZE)) dump_record(dump, addr, pud_val(*pud), PTEDIT_VALID_MASK_PUD);
+    if(pud_leaf(*pud)) continue;
+    stop = dump_pmd(dump, pud, addr, next);
+    if(stop != next) return stop;
+  } while(pud++, addr = next, addr != end);
+  return end;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+static unsigned long dump_p4d(pt_dump_t* dump, vm_t* vm, unsigned long addr, unsigned long end) {
+  p4d_t *p4d = p4d_offset(vm->pgd, addr);
+  unsigned long next, stop;
+  do {
+    next = p4d_addr_end(addr, end);
+    if(p4d_none(*p4d) || p4d_bad(*p4d)) continue;
+    if(dump_full(dump, 3)) return addr;
+    if(PTRS_PER_P4D > 1 && IS_ALIGNED(addr, P4D_SIZE)) dump_record(dump, addr, p4d_val(*p4d), PTEDIT_VALID_MASK_P4D);
+    vm->p4d = p4d;
+    stop = dump_pud(dump, vm, addr, next);
+    if(stop != next) return stop;
+  } while(p4d++, addr = next, addr != end);
+  return end;
+}
+#endif
+
+/* Refills the buffer of a dump with the records following the cursor */
+static void dump_fill(pt_dump_t* dump) {
+  unsigned long addr = dump->cursor, end = dump->end, next, stop;
+  vm_t vm;
+
+  dump->len = dump->off = 0;
+  lock_mm_read(dump->mm);
+  vm.pgd = pgd_offset(dump->mm, addr);
+  do {
+    next = pgd_addr_end(addr, end);
+    if(pgd_none(*vm.pgd) || pgd_bad(*vm.pgd)) continue;
+    if(dump_full(dump, 4)) break;
+    if(IS_ALIGNED(addr, PGDIR_SIZE)) dump_record(dump, addr, pgd_val(*vm.pgd), PTEDIT_VALID_MASK_PGD);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+    stop = dump_p4d(dump, &vm, addr, next);
+#else
+    stop = dump_pud(dump, &vm, addr, next);
+#endif
+    if(stop != next) {
+      addr = stop;
+      break;
+    }
+  } while(vm.pgd++, addr = next, addr != end);
+  unlock_mm_read(dump->mm);
+  dump->cursor = addr;
+}
+
+static ssize_t dump_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+  pt_dump_t* dump = iocb->ki_filp->private_data;
+  ssize_t copied = 0;
+
+  mutex_lock(&dump->lock);
+  while(iov_iter_count(to)) {
+    size_t n;
+    if(dump->off == dump->len) {
+      if(dump->cursor >= dump->end) break;
+      if(fatal_signal_pending(current)) {
+        if(!copied) copied = -EINTR;
+        break;
+      }
+      dump_fill(dump);
+      /* A refill without any record reached the end (or could not make progress) */
+      if(!dump->len) break;
+      cond_resched();
+      continue;
+    }
+    n = copy_to_iter(dump->buffer + dump->off, dump->len - dump->off, to);
+    if(!n) {
+      if(!copied) copied = -EFAULT;
+      break;
+    }
+    dump->off += n;
+    copied += n;
+  }
+  mutex_unlock(&dump->lock);
+
+  if(copied > 0) iocb->ki_pos += copied;
+  return copied;
+}
+
+static int dump_release(struct inode *inode, struct file *file) {
+  pt_dump_t* dump = file->private_data;
+  mmput(dump->mm);
+  kvfree(dump);
+  return 0;
+}
+
+static const struct file_operations dump_ops = {
+  .owner = THIS_MODULE,
+  .read_iter = dump_read_iter,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+  .splice_read = copy_splice_read,
+#else
+  .splice_read = generic_file_splice_read,
+#endif
+  .release = dump_release,
+};
+
+/* Returns a new file descriptor streaming the page tables of pid */
+static int dump_open(pteditor_ctx_t* ctx, size_t pid) {
+  struct mm_struct* mm = get_mm(ctx, pid);
+  ptedit_dump_header_t header;
+  pt_dump_t* dump;
+  int fd;
+
+  if(!mm || !mmget_not_zero(mm)) return -ESRCH;
+  dump = alloc_buffer(sizeof(pt_dump_t));
+  if(!dump) {
+    mmput(mm);
+    return -ENOMEM;
+  }
+  mutex_init(&dump->lock);
+  dump->mm = mm;
+  dump->cursor = 0;
+  dump->end = mm->task_size;
+
+  header.magic = PTEDITOR_DUMP_MAGIC;
+  header.version = PTEDITOR_DUMP_VERSION;
+  header.record_size = sizeof(ptedit_dump_record_t);
+  header.pid = pid;
+  memcpy(dump->buffer, &header, sizeof(header));
+  dump->len = sizeof(header);
+  dump->off = 0;
+
+  fd = anon_inode_getfd("[pteditor-dump]", &dump_ops, dump, O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    mmput(mm);
+    kvfree(dump);
+  }
+  return fd;
+}
+
+/*
+ * PTE file, the 8 bytes at offset (va / PAGE_SIZE) * 8 are the raw leaf entry mapping va (0 if there is none).
+ * It holds a reference to the device file, as updates use its TLB invalidation and transaction.
+ */
+typedef struct {
+  struct file* device;
+  pteditor_ctx_t* ctx;
+  struct mm_struct* mm;
+  size_t pid;
+  /* Global process id of pid when the file was opened, for the update tracepoint */
+  pid_t tgid;
+  unsigned long end;
+} pte_file_t;
+
+typedef struct {
+  unsigned long start;
+  size_t* values;
+} pte_file_chunk_t;
+
+static void pte_file_entry(range_walk_t* walk, vm_t* vm, unsigned long addr, unsigned long next) {
+  pte_file_chunk_t* chunk = walk->private;
+  ptedit_entry_t entry;
+  size_t leaf = 0;
+
+  memset(&entry, 0, sizeof(entry));
+  vm_to_user(&entry, vm);
+  if(vm->valid & PTEDIT_VALID_MASK_PTE) {
+    leaf = entry.pte;
+  } else if((vm->valid & PTEDIT_VALID_MASK_PMD) && pmd_leaf(*vm->pmd)) {
+    leaf = entry.pmd;
+  } else if((vm->valid & PTEDIT_VALID_MASK_PUD) && pud_leaf(*vm->pud)) {
+    leaf = entry.pud;
+  }
+  for(; addr != next; addr += PAGE_SIZE) {
+    chunk->values[(addr - chunk->start) >> PAGE_SHIFT] = leaf;
+  }
+}
+
+/* Reads the leaf entries of count pages starting at start, the caller is responsible for locking mm */
+static void pte_file_read_chunk(pte_file_t* pf, unsigned long start, size_t count, size_t* values) {
+  pte_file_chunk_t chunk;
+  range_walk_t walk;
+  chunk.start = start;
+  chunk.values = values;
+  walk.entry = pte_file_entry;
+  walk.descend = NULL;
+  walk.unlock = NULL;
+  walk.private = &chunk;
+  walk_range(pf->mm, start, start + count * PAGE_SIZE, &walk);
+}
+
+/* Returns the number of entries of the next chunk at pos, 0 at the end of the file */
+static size_t pte_file_chunk(pte_file_t* pf, loff_t pos, size_t bytes) {
+  unsigned long start;
+  size_t count = min_t(size_t, bytes / sizeof(size_t), PTEDITOR_PTE_FILE_CHUNK);
+  /* Checked before shifting, as the address of a large offset would wrap around */
+  if(pos >= (pf->end >> PAGE_SHIFT) * sizeof(size_t)) return 0;
+  start = (pos / sizeof(size_t)) << PAGE_SHIFT;
+  return min_t(size_t, count, (pf->end - start) >> PAGE_SHIFT);
+}
+
+static int pte_file_needs_lock(pte_file_t* pf) {
+  return mm_needs_lock(pf->ctx, pf->mm);
+}
+
+static ssize_t pte_file_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+  pte_file_t* pf = iocb->ki_filp->private_data;
+  int lock = pte_file_needs_lock(pf);
+  loff_t pos = iocb->ki_pos;
+  ssize_t copied = 0;
+  size_t* values;
+  size_t count;
+
+  if(pos < 0 || pos % sizeof(size_t) || iov_iter_count(to) % sizeof(size_t)) return -EINVAL;
+  values = kmalloc(PTEDITOR_PTE_FILE_CHUNK * sizeof(size_t), GFP_KERNEL);
+  if(!values) return -ENOMEM;
+
+  while((count = pte_file_chunk(pf, pos, iov_iter_count(to)))) {
+    size_t n;
+    if(lock) lock_mm_read(pf->mm);
+    pte_file_read_chunk(pf, (pos / sizeof(size_t)) << PAGE_SHIFT, count, values);
+    if(lock) unlock_mm_read(pf->mm);
+    /* Copy out only after unlocking, as the buffer might fault */
+    n = copy_to_iter(values, count * sizeof(size_t), to);
+    copied += n;
+    pos += n;
+    if(n != count * sizeof(size_t)) {
+      if(!copied) copied = -EFAULT;
+      break;
+    }
+  }
+
+  kfree(values);
+  iocb->ki_pos = pos;
+  return copied;
+}
+
+static ssize_t pte_file_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+  pte_file_t* pf = iocb->ki_filp->private_data;
+  pteditor_ctx_t* ctx = pf->ctx;
+  int lock = pte_file_needs_lock(pf), entered;
+  unsigned long flush_start = ULONG_MAX, flush_end = 0;
+  loff_t pos = iocb->ki_pos;
+  ssize_t written = 0;
+  size_t *values, *old;
+  size_t count, i;
+
+  if(pos < 0 || pos % sizeof(size_t) || iov_iter_count(from) % sizeof(size_t)) return -EINVAL;
+  values = kmalloc(2 * PTEDITOR_PTE_FILE_CHUNK * sizeof(size_t), GFP_KERNEL);
+  if(!values) return -ENOMEM;
+  old = values + PTEDITOR_PTE_FILE_CHUNK;
+
+  while((count = pte_file_chunk(pf, pos, iov_iter_count(from)))) {
+    unsigned long start = (pos / sizeof(size_t)) << PAGE_SHIFT;
+    /* Copy in before locking, as the buffer might fault */
+    if(copy_from_iter(values, count * sizeof(size_t), from) != count * sizeof(size_t)) {
+      if(!written) written = -EFAULT;
+      break;
+    }
+    /* Only the locked range of a range-locked mm can be updated */
+    if(outside_locked_range(ctx, pf->mm, start, start + count * PAGE_SIZE - 1)) {
+      if(!written) written = -ERANGE;
+      break;
+    }
+    if(lock) lock_mm_read(pf->mm);
+    entered = range_enter(ctx, pf->mm);
+    pte_file_read_chunk(pf, start, count, old);
+    for(i = 0; i < count; i++) {
+      ptedit_entry_t entry;
+      if(values[i] == old[i]) continue;
+      memset(&entry, 0, sizeof(entry));
+      entry.pid = pf->pid;
+      entry.vaddr = start + i * PAGE_SIZE;
+      entry.pte = values[i];
+      entry.valid = PTEDIT_VALID_MASK_PTE;
+      /* Without a PTE (unmapped or huge page), the write ends short before the entry */
+      if(!update_vm_mm(pf->mm, &entry, pf->tgid)) break;
+      flush_start = min(flush_start, (unsigned long)entry.vaddr);
+      flush_end = max(flush_end, (unsigned long)entry.vaddr + PAGE_SIZE);
+    }
+    range_leave(ctx, entered);
+    if(lock) unlock_mm_read(pf->mm);
+    written += i * sizeof(size_t);
+    pos += i * sizeof(size_t);
+    if(i != count) {
+      if(!written) written = -ENOENT;
+      break;
+    }
+  }
+
+  /* A single shootdown covering all entries changed by this write */
+  if(flush_start < flush_end) {
+    if(lock) lock_mm_read(pf->mm);
+    txn_invalidate_tlb_range(ctx, pf->mm, flush_start, flush_end);
+    if(lock) unlock_mm_read(pf->mm);
+  }
+
+  kfree(values);
+  iocb->ki_pos = pos;
+  return written;
+}
+
+static loff_t pte_file_llseek(struct file *file, loff_t offset, int whence) {
+  pte_file_t* pf = file->private_data;
+  return fixed_size_llseek(file, offset, whence, (pf->end >> PAGE_SHIFT) * sizeof(size_t));
+}
+
+static void pte_file_free(pte_file_t* pf) {
+  mmput(pf->mm);
+  fput(pf->device);
+  kfree(pf);
+}
+
+static int pte_file_release(struct inode *inode, struct file *file) {
+  pte_file_free(file->private_data);
+  return 0;
+}
+
+static const struct file_operations pte_file_ops = {
+  .owner = THIS_MODULE,
+  .llseek = pte_file_llseek,
+  .read_iter = pte_file_read_iter,
+  .write_iter = pte_file_write_iter,
+  .release = pte_file_release,
+};
+
+/* Returns a new file descriptor for random access to the leaf entries of pid */
+static int pte_file_open(pteditor_ctx_t* ctx, struct file* device, size_t pid) {
+  struct mm_struct* mm = get_mm(ctx, pid);
+  struct file* file;
+  pte_file_t* pf;
+  int fd;
+
+  if(!mm || !mmget_not_zero(mm)) return -ESRCH;
+  pf = kzalloc(sizeof(pte_file_t), GFP_KERNEL);
+  if(!pf) {
+    mmput(mm);
+    return -ENOMEM;
+  }
+  pf->device = get_file(device);
+  pf->ctx = ctx;
+  pf->mm = mm;
+  pf->pid = pid;
+  pf->tgid = request_tgid(ctx, pid);
+  pf->end = mm->task_size;
+
+  fd = get_unused_fd_flags(O_CLOEXEC);
+  if(fd < 0) {
+    pte_file_free(pf);
+    return fd;
+  }
+  file = anon_inode_getfile("[pteditor-pte]", &pte_file_ops, pf, O_RDWR | O_LARGEFILE);
+  if(IS_ERR(file)) {
+    put_unused_fd(fd);
+    pte_file_free(pf);
+    return PTR_ERR(file);
+  }
+  /* Anonymous files are not seekable by default */
+  file->f_mode |= FMODE_PREAD | FMODE_PWRITE;
+#ifdef FMODE_LSEEK
+  file->f_mode |= FMODE_LSEEK;
+#endif
+  fd_install(fd, file);
+  return fd;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+/*
+ * Watch of a virtual address range, the mmu_notifier callbacks queue records which are read from the file.
+ * The watch only holds mm_count, i.e., it does not keep the address space alive and reports its exit.
+ */
+typedef struct {
+  struct mmu_notifier notifier;
+  struct mm_struct* mm;
+  unsigned long start, end;
+  spinlock_t lock;
+  wait_queue_head_t wait;
+  size_t head, count;
+  ptedit_watch_record_t records[PTEDITOR_WATCH_QUEUE];
+} pt_watch_t;
+
+static void watch_push(pt_watch_t* watch, unsigned long start, unsigned long end, size_t event) {
+  ptedit_watch_record_t* last;
+
+  start = max(start, watch->start);
+  end = min(end, watch->end);
+  if(start >= end) return;
+
+  /* Callbacks can be called with page-table locks held */
+  spin_lock(&watch->lock);
+  last = watch->count ? &watch->records[(watch->head + watch->count - 1) % PTEDITOR_WATCH_QUEUE] : NULL;
+  if(last && last->event == event && start <= last->end && end >= last->start) {
+    last->start = min((unsigned long)last->start, start);
+    last->end = max((unsigned long)last->end, end);
+  } else if(watch->count == PTEDITOR_WATCH_QUEUE) {
+    watch->head = 0;
+    watch->count = 1;
+    watch->records[0].start = watch->start;
+    watch->records[0].end = watch->end;
+    watch->records[0].event = PTEDITOR_WATCH_OVERFLOW;
+  } else {
+    last = &watch->records[(watch->head + watch->count) % PTEDITOR_WATCH_QUEUE];
+    last->start = start;
+    last->end = end;
+    last->event = event;
+    watch->count++;
+  }
+  spin_unlock(&watch->lock);
+  wake_up_interruptible(&watch->wait);
+}
+
+static size_t watch_event(const struct mmu_notifier_range* range) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+  switch(range->event) {
+    case MMU_NOTIFY_UNMAP: return PTEDITOR_WATCH_UNMAP;
+    case MMU_NOTIFY_CLEAR: return PTEDITOR_WATCH_CLEAR;
+    case MMU_NOTIFY_PROTECTION_VMA:
+    case MMU_NOTIFY_PROTECTION_PAGE: return PTEDITOR_WATCH_PROTECTION;
+    case MMU_NOTIFY_SOFT_DIRTY: return PTEDITOR_WATCH_SOFT_DIRTY;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+    case MMU_NOTIFY_MIGRATE: return PTEDITOR_WATCH_MIGRATE;
+#endif
+    default: return PTEDITOR_WATCH_OTHER;
+  }
+#else
+  return PTEDITOR_WATCH_OTHER;
+#endif
+}
+
+/* Reported once the change is complete, such that resolving the range afterwards yields the new entries */
+static void watch_invalidate_range_end(struct mmu_notifier* notifier, const struct mmu_notifier_range* range) {
+  pt_watch_t* watch = container_of(notifier, pt_watch_t, notifier);
+  watch_push(watch, range->start, range->end, watch_event(range));
 }
 
-static struct mm_struct* get_mm(size_t pid) {
-  struct task_struct *task;
-  struct pid* vpid;
+static void watch_mm_release(struct mmu_notifier* notifier, struct mm_struct* mm) {
+  pt_watch_t* watch = container_of(notifier, pt_watch_t, notifier);
+  watch_push(watch, watch->start, watch->end, PTEDITOR_WATCH_RELEASE);
+}
 
-  /* Find mm */
-  task = current;
-  if(pid != 0) {
-    vpid = find_vpid(pid);
-    if(!vpid) return NULL;
-    task = pid_task(vpid, PIDTYPE_PID);
-    if(!task) return NULL;
+static const struct mmu_notifier_ops watch_notifier_ops = {
+  .release = watch_mm_release,
+  .invalidate_range_end = watch_invalidate_range_end,
+};
+
+static ssize_t watch_read(struct file* file, char __user* buffer, size_t size, loff_t* offset) {
+  pt_watch_t* watch = file->private_data;
+  ptedit_watch_record_t records[16];
+  size_t max_records = min(size / sizeof(ptedit_watch_record_t), ARRAY_SIZE(records)), n;
+  int ret;
+
+  if(!max_records) return -EINVAL;
+
+  spin_lock(&watch->lock);
+  while(!watch->count) {
+    spin_unlock(&watch->lock);
+    if(file->f_flags & O_NONBLOCK) return -EAGAIN;
+    ret = wait_event_interruptible(watch->wait, READ_ONCE(watch->count));
+    if(ret) return ret;
+    spin_lock(&watch->lock);
   }
-  if(task->mm) {
-      return task->mm;
-  } else {
-      return task->active_mm;
+  for(n = 0; n < max_records && watch->count; n++) {
+    records[n] = watch->records[watch->head];
+    watch->head = (watch->head + 1) % PTEDITOR_WATCH_QUEUE;
+    watch->count--;
   }
-  return NULL;
-}
+  spin_unlock(&watch->lock);
 
-static int resolve_vm(size_t addr, vm_t* entry, int lock) {
-  struct mm_struct *mm;
-
-  if(!entry) return 1;
-  entry->pud = NULL;
-  entry->pmd = NULL;
-  entry->pgd = NULL;
-  entry->pte = NULL;
-  entry->p4d = NULL;
-  entry->valid = 0;
+  if(to_user(buffer, records, n * sizeof(ptedit_watch_record_t))) return -EFAULT;
+  return n * sizeof(ptedit_watch_record_t);
+}
 
-  mm = get_mm(entry->pid);
-  if(!mm) {
-      return 1;
-  }
+static __poll_t watch_poll(struct file* file, poll_table* wait) {
+  pt_watch_t* watch = file->private_data;
+  poll_wait(file, &watch->wait, wait);
+  return READ_ONCE(watch->count) ? (EPOLLIN | EPOLLRDNORM) : 0;
+}
 
-  /* Lock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_lock(mm);
-#else
-  if(lock) down_read(&mm->mmap_sem);
-#endif
+static void watch_free(pt_watch_t* watch) {
+  /* Waits for running callbacks, also works if the address space already exited */
+  mmu_notifier_unregister(&watch->notifier, watch->mm);
+  mmdrop(watch->mm);
+  kvfree(watch);
+}
 
-  /* Return PGD (page global directory) entry */
-  entry->pgd = pgd_offset(mm, addr);
-  if (pgd_none(*(entry->pgd)) || pgd_bad(*(entry->pgd))) {
-      entry->pgd = NULL;
-      goto error_out;
-  }
-  entry->valid |= PTEDIT_VALID_MASK_PGD;
+static int watch_release(struct inode* inode, struct file* file) {
+  watch_free(file->private_data);
+  return 0;
+}
 
+static const struct file_operations watch_ops = {
+  .owner = THIS_MODULE,
+  .read = watch_read,
+  .poll = watch_poll,
+  .release = watch_release,
+};
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-  /* Return p4d offset */
-  entry->p4d = p4d_offset(entry->pgd, addr);
-  if (p4d_none(*(entry->p4d)) || p4d_bad(*(entry->p4d))) {
-    entry->p4d = NULL;
-    goto error_out;
+/* Returns a new file descriptor delivering the page-table changes of a range */
+static int watch_open(pteditor_ctx_t* ctx, ptedit_watch_t* args) {
+  struct mm_struct* mm;
+  pt_watch_t* watch;
+  int ret;
+
+  if(!args->length || args->vaddr + args->length < args->vaddr) return -EINVAL;
+  mm = get_mm(ctx, args->pid);
+  if(!mm || !mmget_not_zero(mm)) return -ESRCH;
+  /* Registering takes the mmap lock for writing */
+  if(!needs_lock(ctx, args->pid)) {
+    ret = -EBUSY;
+    goto out;
   }
-  entry->valid |= PTEDIT_VALID_MASK_P4D;
 
-  /* Get offset of PUD (page upper directory) */
-  entry->pud = pud_offset(entry->p4d, addr);
-  if (pud_none(*(entry->pud))) {
-    entry->pud = NULL;
-    goto error_out;
+  watch = alloc_buffer(sizeof(pt_watch_t));
+  if(!watch) {
+    ret = -ENOMEM;
+    goto out;
   }
-  entry->valid |= PTEDIT_VALID_MASK_PUD;
-#else
-  /* Get offset of PUD (page upper directory) */
-  entry->pud = pud_offset(entry->pgd, addr);
-  if (pud_none(*(entry->pud))) {
-    entry->pud = NULL;
-    goto error_out;
+  memset(watch, 0, sizeof(pt_watch_t));
+  spin_lock_init(&watch->lock);
+  init_waitqueue_head(&watch->wait);
+  watch->start = args->vaddr & PAGE_MASK;
+  watch->end = PAGE_ALIGN(args->vaddr + args->length);
+  if(!watch->end) watch->end = ULONG_MAX;
+  watch->notifier.ops = &watch_notifier_ops;
+  watch->mm = mm;
+
+  ret = mmu_notifier_register(&watch->notifier, mm);
+  if(ret) {
+    kvfree(watch);
+    goto out;
   }
-  entry->valid |= PTEDIT_VALID_MASK_PUD;
-#endif
+  mmgrab(mm);
 
+  ret = anon_inode_getfd("[pteditor-watch]", &watch_ops, watch, O_RDONLY | O_CLOEXEC);
+  if(ret < 0) watch_free(watch);
 
-  /* Get offset of PMD (page middle directory) */
-  entry->pmd = pmd_offset(entry->pud, addr);
-  if (pmd_none(*(entry->pmd)) || pud_leaf(*(entry->pud))) {
-    entry->pmd = NULL;
-    goto error_out;
+out:
+  mmput(mm);
+  return ret;
+}
+#endif
+
+/* Executes one request of the command ring, the entry is in kernel memory */
+static long ring_execute(pteditor_ctx_t* ctx, ptedit_ring_entry_t* req) {
+  switch(req->cmd) {
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE:
+    {
+      int path = resolve_vm(ctx, &req->entry, needs_lock(ctx, req->entry.pid));
+      if(path < 0) return path;
+      atomic64_inc(&ctx->resolve_path[path]);
+      stats_walk(req->entry.valid);
+      return 0;
+    }
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE:
+    {
+      int ret = update_vm(ctx, &req->entry, needs_lock(ctx, req->entry.pid));
+      return (ret < 0) ? ret : 0;
+    }
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID:
+      txn_invalidate_tlb(ctx, req->entry.pid, (void*)req->entry.vaddr);
+      return 0;
+    default:
+      return -EINVAL;
   }
-  entry->valid |= PTEDIT_VALID_MASK_PMD;
+}
 
-  /* Map PTE (page table entry) */
-#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 5, 0)
-  entry->pte = pte_offset_map(entry->pmd, addr);
-#else
-  entry->pte = pte_offset_kernel(entry->pmd, addr);
-#endif
-  if (entry->pte == NULL || pmd_leaf(*(entry->pmd))) {
-    entry->pte = NULL;
-    goto error_out;
+/* Executes all submitted requests of the command ring in order, returns the number of requests */
+static size_t ring_process(pteditor_ctx_t* ctx) {
+  ptedit_ring_t* ring = ctx->ring;
+  size_t tail = smp_load_acquire(&ring->tail);
+  size_t done = 0;
+
+  /* User space cannot have submitted more requests than the ring holds */
+  if(tail - ctx->ring_head > PTEDITOR_RING_ENTRIES) return 0;
+
+  while(ctx->ring_head != tail) {
+    ptedit_ring_entry_t* slot = &ring->entries[ctx->ring_head & (PTEDITOR_RING_ENTRIES - 1)];
+    ptedit_ring_entry_t req;
+    /* Work on a copy, user space can modify the slot at any time */
+    memcpy(&req, slot, sizeof(req));
+    req.result = (size_t)ring_execute(ctx, &req);
+    memcpy(slot, &req, sizeof(req));
+    ctx->ring_head++;
+    smp_store_release(&ring->head, ctx->ring_head);
+    done++;
   }
-  entry->valid |= PTEDIT_VALID_MASK_PTE;
+  return done;
+}
 
-  /* Unmap PTE, fine on x86 and ARM64 -> unmap is NOP */
-  pte_unmap(entry->pte);
+static int ring_poll_thread(void* data) {
+  pteditor_ctx_t* ctx = data;
+  ptedit_ring_t* ring = ctx->ring;
+  struct mm_struct* attached;
+  unsigned long idle = jiffies + msecs_to_jiffies(PTEDITOR_RING_IDLE_MS);
+
+  while(!kthread_should_stop()) {
+    if(smp_load_acquire(&ring->tail) != ctx->ring_head) {
+      /* The address space is only used for a batch while it is alive, the thread ends once the process exited */
+      if(!mmget_not_zero(ctx->ring_mm)) break;
+      kthread_use_mm(ctx->ring_mm);
+      attached = attach_enter(ctx);
+      ring_process(ctx);
+      attach_leave(ctx, attached);
+      kthread_unuse_mm(ctx->ring_mm);
+      mmput(ctx->ring_mm);
+      idle = jiffies + msecs_to_jiffies(PTEDITOR_RING_IDLE_MS);
+    } else if(time_before(jiffies, idle)) {
+      cond_resched();
+    } else {
+      /* User space checks the flag after submitting and wakes the thread with RING_ENTER */
+      set_current_state(TASK_INTERRUPTIBLE);
+      WRITE_ONCE(ring->flags, PTEDITOR_RING_NEED_WAKEUP);
+      smp_mb();
+      if(smp_load_acquire(&ring->tail) == ctx->ring_head && !kthread_should_stop()) schedule();
+      __set_current_state(TASK_RUNNING);
+      WRITE_ONCE(ring->flags, 0);
+      idle = jiffies + msecs_to_jiffies(PTEDITOR_RING_IDLE_MS);
+    }
+  }
+  WRITE_ONCE(ctx->ring_exited, true);
+  return 0;
+}
 
-  /* Unlock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_unlock(mm);
-#else
-  if(lock) up_read(&mm->mmap_sem);
-#endif
+static int ring_setup(pteditor_ctx_t* ctx, size_t flags) {
+  int ret = 0;
 
-  return 0;
+  mutex_lock(&ctx->ring_lock);
+  if(ctx->ring) {
+    ret = -EBUSY;
+    goto out;
+  }
+  ctx->ring = vmalloc_user(sizeof(ptedit_ring_t));
+  if(!ctx->ring) {
+    ret = -ENOMEM;
+    goto out;
+  }
+  ctx->ring_head = 0;
+
+  if(flags & PTEDITOR_RING_SQPOLL) {
+    struct task_struct* thread;
+    if(!current->mm) {
+      ret = -ESRCH;
+    } else {
+      /* Set up before the thread runs, as it identifies itself by ring_thread */
+      thread = kthread_create(ring_poll_thread, ctx, "pteditor-ring");
+      if(IS_ERR(thread)) {
+        ret = PTR_ERR(thread);
+      } else {
+        mmgrab(current->mm);
+        ctx->ring_mm = current->mm;
+        ctx->ring_pid = get_task_pid(current, PIDTYPE_PID);
+        ctx->ring_ns = get_pid_ns(task_active_pid_ns(current));
+        /* The thread can end on its own once the process exited, it is only freed after kthread_stop */
+        get_task_struct(thread);
+        ctx->ring_thread = thread;
+        wake_up_process(thread);
+      }
+    }
+    if(ret) {
+      vfree(ctx->ring);
+      ctx->ring = NULL;
+    }
+  }
 
-error_out:
+out:
+  mutex_unlock(&ctx->ring_lock);
+  return ret;
+}
 
-  /* Unlock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_unlock(mm);
-#else
-  if(lock) up_read(&mm->mmap_sem);
-#endif
+/* Wakes the polling thread, or executes the submitted requests if there is none */
+static long ring_enter(pteditor_ctx_t* ctx) {
+  long ret = 0;
+
+  mutex_lock(&ctx->ring_lock);
+  if(!ctx->ring) {
+    ret = -EINVAL;
+  } else if(ctx->ring_thread && READ_ONCE(ctx->ring_exited)) {
+    /* Lets a submitter waiting for completion detect that the thread is gone */
+    ret = -ESRCH;
+  } else if(ctx->ring_thread) {
+    wake_up_process(ctx->ring_thread);
+  } else {
+    ret = ring_process(ctx);
+  }
+  mutex_unlock(&ctx->ring_lock);
+  return ret;
+}
 
-  return 1;
+static void ring_destroy(pteditor_ctx_t* ctx) {
+  if(ctx->ring_thread) {
+    kthread_stop(ctx->ring_thread);
+    put_task_struct(ctx->ring_thread);
+    mmdrop(ctx->ring_mm);
+    put_pid(ctx->ring_pid);
+    put_pid_ns(ctx->ring_ns);
+  }
+  /* The file is only released after the ring is unmapped */
+  vfree(ctx->ring);
 }
 
+static void pt_mapping_open(struct vm_area_struct *vma) {
+  pt_mapping_t* mapping = vma->vm_private_data;
+  atomic_inc(&mapping->users);
+}
 
-static int update_vm(ptedit_entry_t* new_entry, int lock) {
-  vm_t old_entry;
-  size_t addr = new_entry->vaddr;
-  struct mm_struct *mm = get_mm(new_entry->pid);
-  if(!mm) return 1;
+static void pt_mapping_close(struct vm_area_struct *vma) {
+  pt_mapping_t* mapping = vma->vm_private_data;
+  size_t i;
+  if(!atomic_dec_and_test(&mapping->users)) return;
+  for(i = 0; i < mapping->count; i++) {
+    put_page(mapping->pages[i]);
+  }
+  kvfree(mapping);
+}
 
-  old_entry.pid = new_entry->pid;
+static const struct vm_operations_struct pt_mapping_ops = {
+  .open = pt_mapping_open,
+  .close = pt_mapping_close,
+};
 
-  /* Lock mm */
+/*
+ * Maps the last-level page tables of the range set with PT_MAP, page i of the mapping is the page
+ * table of the i-th PMD region of the range. The caller holds the mmap lock of current->mm.
+ */
+static int pt_mmap(pteditor_ctx_t* ctx, struct vm_area_struct *vma) {
+  ptedit_pt_map_t range;
+  struct mm_struct* mm;
+  pt_mapping_t* mapping;
+  unsigned long start, tables, i;
+  bool locked = false;
+  int ret = 0;
+
+  mutex_lock(&ctx->lock);
+  range = ctx->pt_map;
+  mutex_unlock(&ctx->lock);
+  if(!range.length) return -EINVAL;
+
+  start = range.vaddr & PMD_MASK;
+  tables = ((range.vaddr + range.length - 1) >> PMD_SHIFT) - (start >> PMD_SHIFT) + 1;
+  if(vma_pages(vma) > tables) return -EINVAL;
+  tables = vma_pages(vma);
+
+  mm = get_mm(ctx, range.pid);
+  if(!mm) return -ESRCH;
+
+  mapping = alloc_buffer(sizeof(pt_mapping_t) + tables * sizeof(struct page*));
+  if(!mapping) return -ENOMEM;
+  atomic_set(&mapping->users, 1);
+  mapping->count = 0;
+
+  /* Only try to lock other mms, two processes mapping each other's page tables would deadlock otherwise */
+  if(mm != current->mm) {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_write_lock(mm);
+    locked = mmap_read_trylock(mm);
 #else
-  if(lock) down_write(&mm->mmap_sem);
+    locked = down_read_trylock(&mm->mmap_sem);
 #endif
-
-  resolve_vm(addr, &old_entry, 0);
-
-  /* Update entries */
-  if((old_entry.valid & PTEDIT_VALID_MASK_PGD) && (new_entry->valid & PTEDIT_VALID_MASK_PGD)) {
-      pr_warn("Updating PGD\n");
-      set_pgd(old_entry.pgd, native_make_pgd(new_entry->pgd));
-  }
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-  if((old_entry.valid & PTEDIT_VALID_MASK_P4D) && (new_entry->valid & PTEDIT_VALID_MASK_P4D)) {
-      pr_warn("Updating P4D\n");
-      set_p4d(old_entry.p4d, native_make_p4d(new_entry->p4d));
+    if(!locked) ret = -EAGAIN;
   }
-#endif
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PUD) && (new_entry->valid & PTEDIT_VALID_MASK_PUD)) {
-      pr_warn("Updating PUD\n");
-      set_pud(old_entry.pud, native_make_pud(new_entry->pud));
+  for(i = 0; !ret && i < tables; i++) {
+    vm_t vm;
+    resolve_vm_mm(mm, start + i * PMD_SIZE, &vm);
+    if(!(vm.valid & PTEDIT_VALID_MASK_PTE)) {
+      /* No page table, e.g., unmapped or mapped by a huge page */
+      ret = -ENOENT;
+      break;
+    }
+    mapping->pages[i] = pmd_page(*vm.pmd);
+    get_page(mapping->pages[i]);
+    mapping->count++;
+    ret = remap_pfn_range(vma, vma->vm_start + i * PAGE_SIZE, page_to_pfn(mapping->pages[i]), PAGE_SIZE, vma->vm_page_prot);
   }
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PMD) && (new_entry->valid & PTEDIT_VALID_MASK_PMD)) {
-      pr_warn("Updating PMD\n");
-      set_pmd(old_entry.pmd, native_make_pmd(new_entry->pmd));
-  }
+  if(locked) unlock_mm_read(mm);
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PTE) && (new_entry->valid & PTEDIT_VALID_MASK_PTE)) {
-      pr_warn("Updating PTE\n");
-      set_pte(old_entry.pte, native_make_pte(new_entry->pte));
+  if(ret) {
+    for(i = 0; i < mapping->count; i++) {
+      put_page(mapping->pages[i]);
+    }
+    kvfree(mapping);
+    return ret;
   }
 
-  invalidate_tlb(old_entry.pid, (void*) addr);
-
-  /* Unlock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_write_unlock(mm);
+  /* The mapping cannot grow beyond the mapped page tables, and core dumps skip them */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+  vm_flags_set(vma, VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP);
 #else
-  if(lock) up_write(&mm->mmap_sem);
+  vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
 #endif
-
+  vma->vm_private_data = mapping;
+  vma->vm_ops = &pt_mapping_ops;
   return 0;
 }
 
+static int device_mmap(struct file *file, struct vm_area_struct *vma) {
+  pteditor_ctx_t* ctx = file->private_data;
+  int ret;
 
-static void vm_to_user(ptedit_entry_t* user, vm_t* vm) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-#if CONFIG_PGTABLE_LEVELS > 4
-    if(vm->p4d) user->p4d = (vm->p4d)->p4d;
-#else
-#if !defined(__ARCH_HAS_5LEVEL_HACK)
-    if(vm->p4d) user->p4d = (vm->p4d)->pgd.pgd;
-#else
-    if(vm->p4d) user->p4d = (vm->p4d)->pgd;    
-#endif
-#endif
-#endif
-#if defined(__i386__) || defined(__x86_64__)
-    if(vm->pgd) user->pgd = (vm->pgd)->pgd;
-    if(vm->pmd) user->pmd = (vm->pmd)->pmd;
-    if(vm->pud) user->pud = (vm->pud)->pud;
-    if(vm->pte) user->pte = (vm->pte)->pte;
-#elif defined(__aarch64__)
-    if(vm->pgd) user->pgd = pgd_val(*(vm->pgd));
-    if(vm->pmd) user->pmd = pmd_val(*(vm->pmd));
-    if(vm->pud) user->pud = pud_val(*(vm->pud));
-    if(vm->pte) user->pte = pte_val(*(vm->pte));
-#endif
-    user->valid = vm->valid;
+  if(vma->vm_pgoff == (PTEDITOR_MMAP_PAGE_TABLES >> PAGE_SHIFT)) {
+    return pt_mmap(ctx, vma);
+  }
+
+  mutex_lock(&ctx->ring_lock);
+  if(!ctx->ring || vma->vm_pgoff != 0) {
+    ret = -EINVAL;
+  } else {
+    ret = remap_vmalloc_range(vma, ctx->ring, 0);
+  }
+  mutex_unlock(&ctx->ring_lock);
+  return ret;
 }
 
+static long device_ioctl_cmd(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
+  pteditor_ctx_t* ctx = file->private_data;
 
-static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
   switch (ioctl_num) {
     case PTEDITOR_IOCTL_CMD_VM_RESOLVE:
     {
         ptedit_entry_t vm_user;
-        vm_t vm;
+        int path;
         (void)from_user(&vm_user, (void*)ioctl_param, sizeof(vm_user));
-        vm.pid = vm_user.pid;
-        resolve_vm(vm_user.vaddr, &vm, !mm_is_locked);
-        vm_to_user(&vm_user, &vm);
+        path = resolve_vm(ctx, &vm_user, needs_lock(ctx, vm_user.pid));
+        if(path >= 0) atomic64_inc(&ctx->resolve_path[path]);
+        stats_walk(vm_user.valid);
         (void)to_user((void*)ioctl_param, &vm_user, sizeof(vm_user));
+        /* The path is only reported via PTEDITOR_IOCTL_CMD_RESOLVE_STATS, the ioctl returns 0 as before */
+        return 0;
+    }
+    case PTEDITOR_IOCTL_CMD_RESOLVE_STATS:
+    {
+        ptedit_resolve_stats_t stats;
+        int i;
+        for(i = 0; i < PTEDITOR_RESOLVE_PATHS; i++) {
+          stats.path[i] = atomic64_read(&ctx->resolve_path[i]);
+        }
+        if(to_user((void*)ioctl_param, &stats, sizeof(stats))) return -EFAULT;
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH:
+    {
+        ptedit_resolve_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return resolve_vm_batch(ctx, &batch, needs_lock(ctx, batch.pid));
+    }
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE_RANGE:
+    {
+        ptedit_resolve_range_args_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return resolve_vm_range(ctx, &args, needs_lock(ctx, args.pid));
+    }
+    case PTEDITOR_IOCTL_CMD_VM_PTE_MODIFY_RANGE:
+    {
+        ptedit_pte_modify_range_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return pte_modify_range(ctx, &args, needs_lock(ctx, args.pid));
+    }
+    case PTEDITOR_IOCTL_CMD_VM_CMPXCHG:
+    {
+        ptedit_cmpxchg_t args;
+        long ret;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        ret = cmpxchg_vm(ctx, &args, needs_lock(ctx, args.pid));
+        if(!ret && to_user((void*)ioctl_param, &args, sizeof(args))) return -EFAULT;
+        return ret;
+    }
+    case PTEDITOR_IOCTL_CMD_TXN_BEGIN:
+    {
+        return txn_begin(ctx);
+    }
+    case PTEDITOR_IOCTL_CMD_TXN_COMMIT:
+    {
+        ptedit_txn_t result;
+        long ret = txn_commit(ctx, &result);
+        if(!ret && to_user((void*)ioctl_param, &result, sizeof(result))) return -EFAULT;
+        return ret;
+    }
     case PTEDITOR_IOCTL_CMD_VM_UPDATE:
     {
         ptedit_entry_t vm_user;
+        int ret;
         (void)from_user(&vm_user, (void*)ioctl_param, sizeof(vm_user));
-        update_vm(&vm_user, !mm_is_locked);
-        return 0;
+        ret = update_vm(ctx, &vm_user, needs_lock(ctx, vm_user.pid));
+        return (ret < 0) ? ret : 0;
+    }
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH:
+    {
+        ptedit_update_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return update_vm_batch(ctx, &batch, needs_lock(ctx, batch.pid));
     }
     case PTEDITOR_IOCTL_CMD_VM_LOCK:
     {
         struct mm_struct *mm = current->active_mm;
-        if(mm_is_locked) {
+        int ret = 0;
+        mutex_lock(&ctx->lock);
+        if(ctx->mm_is_locked) {
             pr_warn("VM is already locked\n");
-            return -1;
-        }
+            ret = -1;
+        } else {
+            mmgrab(mm);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        mmap_write_lock(mm);
-        mmap_read_lock(mm);
+            mmap_write_lock(mm);
+            mmap_read_lock(mm);
+#else
+            down_write(&mm->mmap_sem);
+            down_read(&mm->mmap_sem);
+#endif
+            ctx->locked_mm = mm;
+            ctx->range_locked = false;
+            ctx->mm_is_locked = true;
+        }
+        mutex_unlock(&ctx->lock);
+        return ret;
+    }
+    case PTEDITOR_IOCTL_CMD_ATTACH:
+    {
+        return attach_mm(ctx, (pid_t)ioctl_param);
+    }
+    case PTEDITOR_IOCTL_CMD_DETACH:
+    {
+        return detach_mm(ctx);
+    }
+    case PTEDITOR_IOCTL_CMD_RING_SETUP:
+    {
+        return ring_setup(ctx, ioctl_param);
+    }
+    case PTEDITOR_IOCTL_CMD_RING_ENTER:
+    {
+        return ring_enter(ctx);
+    }
+    case PTEDITOR_IOCTL_CMD_HARVEST:
+    {
+        ptedit_harvest_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return harvest_range(ctx, &args, needs_lock(ctx, args.pid));
+    }
+    case PTEDITOR_IOCTL_CMD_WATCH_OPEN:
+    {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0) && defined(CONFIG_MMU_NOTIFIER)
+        ptedit_watch_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return watch_open(ctx, &args);
 #else
-        down_write(&mm->mmap_sem);
-        down_read(&mm->mmap_sem);
+        return -EOPNOTSUPP;
 #endif
-        mm_is_locked = true;
+    }
+    case PTEDITOR_IOCTL_CMD_PTE_FILE_OPEN:
+    {
+        return pte_file_open(ctx, file, ioctl_param);
+    }
+    case PTEDITOR_IOCTL_CMD_DUMP_OPEN:
+    {
+        return dump_open(ctx, ioctl_param);
+    }
+    case PTEDITOR_IOCTL_CMD_PT_MAP:
+    {
+        ptedit_pt_map_t range;
+        if(from_user(&range, (void*)ioctl_param, sizeof(range))) return -EFAULT;
+        if(range.vaddr + range.length < range.vaddr) return -EINVAL;
+        mutex_lock(&ctx->lock);
+        ctx->pt_map = range;
+        mutex_unlock(&ctx->lock);
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE:
+    {
+        ptedit_lock_range_t range;
+        if(from_user(&range, (void*)ioctl_param, sizeof(range))) return -EFAULT;
+        return lock_mm_range(ctx, &range);
+    }
     case PTEDITOR_IOCTL_CMD_VM_UNLOCK:
     {
-        struct mm_struct *mm = current->active_mm;
-        if(!mm_is_locked) {
+        if(!ctx->mm_is_locked) {
             pr_warn("VM is not locked\n");
             return -1;
         }
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        mmap_write_unlock(mm);
-        mmap_read_unlock(mm);
-#else
-        up_write(&mm->mmap_sem);
-        up_read(&mm->mmap_sem);
-#endif
-        mm_is_locked = false;
+        unlock_mm(ctx);
         return 0;
     }
     case PTEDITOR_IOCTL_CMD_READ_PAGE:
@@ -499,13 +3425,28 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         (void)from_user(phys_to_virt(page.pfn * real_page_size), page.buffer, real_page_size);
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_READ_PAGES:
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGES:
+    {
+        ptedit_phys_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return copy_phys_batch(&batch, ioctl_num == PTEDITOR_IOCTL_CMD_WRITE_PAGES);
+    }
+    case PTEDITOR_IOCTL_CMD_COPY_PAGES:
+    case PTEDITOR_IOCTL_CMD_FILL_PAGES:
+    case PTEDITOR_IOCTL_CMD_CLEAR_PAGES:
+    {
+        ptedit_phys_op_t op;
+        if(from_user(&op, (void*)ioctl_param, sizeof(op))) return -EFAULT;
+        return phys_op(&op, ioctl_num);
+    }
     case PTEDITOR_IOCTL_CMD_GET_ROOT:
     {
         struct mm_struct *mm;
         ptedit_paging_t paging;
 
         (void)from_user(&paging, (void*)ioctl_param, sizeof(paging));
-        mm = get_mm(paging.pid);
+        mm = get_mm(ctx, paging.pid);
 
 #if defined(__aarch64__)
         if(!mm || (mm && !mm->pgd)) {
@@ -519,15 +3460,15 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
 
         if(!mm) return 1;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_read_lock(mm);
+        if(needs_lock(ctx, paging.pid)) mmap_read_lock(mm);
 #else
-        if(!mm_is_locked) down_read(&mm->mmap_sem);
+        if(needs_lock(ctx, paging.pid)) down_read(&mm->mmap_sem);
 #endif
         paging.root = virt_to_phys(mm->pgd);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_read_unlock(mm);
+        if(needs_lock(ctx, paging.pid)) mmap_read_unlock(mm);
 #else
-        if(!mm_is_locked) up_read(&mm->mmap_sem);
+        if(needs_lock(ctx, paging.pid)) up_read(&mm->mmap_sem);
 #endif
         (void)to_user((void*)ioctl_param, &paging, sizeof(paging));
         return 0;
@@ -538,18 +3479,18 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         ptedit_paging_t paging = {0};
 
         (void)from_user(&paging, (void*)ioctl_param, sizeof(paging));
-        mm = get_mm(paging.pid);
+        mm = get_mm(ctx, paging.pid);
         if(!mm) return 1;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_write_lock(mm);
+        if(needs_lock(ctx, paging.pid)) mmap_write_lock(mm);
 #else
-        if(!mm_is_locked) down_write(&mm->mmap_sem);
+        if(needs_lock(ctx, paging.pid)) down_write(&mm->mmap_sem);
 #endif
         mm->pgd = (pgd_t*)phys_to_virt(paging.root);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_write_unlock(mm);
+        if(needs_lock(ctx, paging.pid)) mmap_write_unlock(mm);
 #else
-        if(!mm_is_locked) up_write(&mm->mmap_sem);
+        if(needs_lock(ctx, paging.pid)) up_write(&mm->mmap_sem);
 #endif
         return 0;
     }
@@ -559,14 +3500,35 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
     {
         ptedit_invalidate_tlb_args_t args;
         (void)from_user(&args, (void*)ioctl_param, sizeof(args));
-        invalidate_tlb(args.pid, args.address);
+        txn_invalidate_tlb(ctx, args.pid, args.address);
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_SHOOTDOWN:
+    {
+        ptedit_shootdown_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return shootdown_user(ctx, &args);
+    }
+    case PTEDITOR_IOCTL_CMD_BENCH:
+    {
+        ptedit_bench_t args;
+        long ret;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        ret = bench(ctx, &args);
+        if(!ret && to_user((void*)ioctl_param, &args, sizeof(args))) return -EFAULT;
+        return ret;
+    }
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE:
+    {
+        ptedit_invalidate_tlb_range_t args;
+        if(from_user(&args, (void*)ioctl_param, sizeof(args))) return -EFAULT;
+        return invalidate_tlb_scoped(ctx, &args);
+    }
     case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB:
     {
         // this is implemented as its own call to stay backwards compatible
         // even in case a user uses the old ioctl calls
-        invalidate_tlb(task_pid_nr(current), (void*) ioctl_param);
+        txn_invalidate_tlb(ctx, task_pid_nr(current), (void*) ioctl_param);
         return 0;
     }
     case PTEDITOR_IOCTL_CMD_GET_PAT:
@@ -600,7 +3562,8 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         return 0;
       }
 #endif
-      invalidate_tlb = ((int)ioctl_param == PTEDITOR_TLB_INVALIDATION_KERNEL) ? invalidate_tlb_kernel : invalidate_tlb_custom;
+      ctx->invalidate_tlb = ((int)ioctl_param == PTEDITOR_TLB_INVALIDATION_KERNEL) ? invalidate_tlb_kernel : invalidate_tlb_custom;
+      ctx->invalidate_tlb_range = ((int)ioctl_param == PTEDITOR_TLB_INVALIDATION_KERNEL) ? invalidate_tlb_range_kernel : invalidate_tlb_range_custom;
       return 0;
     }
 
@@ -611,8 +3574,66 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
   return 0;
 }
 
+static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
+  pteditor_ctx_t* ctx = file->private_data;
+  struct mm_struct* attached;
+  u64 start = stats_now();
+  long ret;
+
+  /* ATTACH and DETACH take attach_sem for writing, all other requests pin the attached mm */
+  if(ioctl_num == PTEDITOR_IOCTL_CMD_ATTACH || ioctl_num == PTEDITOR_IOCTL_CMD_DETACH) {
+    ret = device_ioctl_cmd(file, ioctl_num, ioctl_param);
+  } else {
+    attached = attach_enter(ctx);
+    ret = device_ioctl_cmd(file, ioctl_num, ioctl_param);
+    attach_leave(ctx, attached);
+  }
+  stats_ioctl(ioctl_num, start, ret);
+  return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+/*
+ * Executes a request submitted with IORING_OP_URING_CMD. The command is the ioctl number and
+ * the first 8 bytes of the SQE payload hold the ioctl argument, i.e., a pointer to the request.
+ */
+static int device_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags) {
+  const u64* payload;
+
+  switch(ioucmd->cmd_op) {
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE:
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH:
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE:
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH:
+    case PTEDITOR_IOCTL_CMD_READ_PAGE:
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGE:
+    case PTEDITOR_IOCTL_CMD_READ_PAGES:
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGES:
+    case PTEDITOR_IOCTL_CMD_HARVEST:
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID:
+      break;
+    default:
+      return -ENOTTY;
+  }
+
+  /* All requests can sleep on mm locks, io_uring retries them from a worker thread */
+  if(issue_flags & IO_URING_F_NONBLOCK) return -EAGAIN;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+  payload = io_uring_sqe_cmd(ioucmd->sqe);
+#else
+  payload = ioucmd->cmd;
+#endif
+  return device_ioctl(ioucmd->file, ioucmd->cmd_op, (unsigned long) READ_ONCE(payload[0]));
+}
+#endif
+
 static struct file_operations f_ops = {.owner = THIS_MODULE,
                                        .unlocked_ioctl = device_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+                                       .uring_cmd = device_uring_cmd,
+#endif
+                                       .mmap = device_mmap,
                                        .open = device_open,
                                        .release = device_release};
 
@@ -701,10 +3722,17 @@ static int __init pteditor_init(void) {
     pr_alert("Could not retrieve flush_tlb_mm_range function\n");
     return -ENXIO;
   }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  // optional, only required for invalidations on the current CPU
+  flush_tlb_one_user_func = (void *) kallsyms_lookup_name("flush_tlb_one_user");
+  flush_tlb_local_func = (void *) kallsyms_lookup_name("flush_tlb_local");
 #endif
-  // we use the kernel TLB invalidation function by default as it's more reliable
-  invalidate_tlb = invalidate_tlb_kernel;
-  
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0) && defined(CONFIG_PER_VMA_LOCK)
+  // optional, resolving falls back to the mmap lock without it
+  lock_vma_under_rcu_func = (void *) kallsyms_lookup_name("lock_vma_under_rcu");
+#endif
+
 #if defined(__aarch64__)
   asm volatile("mrs %0, tcr_el1" : "=r" (tcr_el1));
   switch((tcr_el1 >> 14) & 3) {
@@ -745,6 +3773,14 @@ static int __init pteditor_init(void) {
     pr_info("Unprivileged memory access via /proc/umem set up\n");
     has_umem = 1;
   }
+  // optional, the statistics are not collected without them
+  pteditor_stats = alloc_percpu(pteditor_stats_t);
+  if(pteditor_stats) {
+    stats_dir = debugfs_create_dir("pteditor", NULL);
+    debugfs_create_file("stats", 0400, stats_dir, NULL, &stats_ops);
+    debugfs_create_file("reset", 0200, stats_dir, NULL, &stats_reset_ops);
+  }
+
   pr_info("Loaded.\n");
 
   return 0;
@@ -759,6 +3795,8 @@ static void __exit pteditor_exit(void) {
     pr_info("Remove unprivileged memory access\n");
     remove_proc_entry("umem", NULL);
   }
+  debugfs_remove_recursive(stats_dir);
+  free_percpu(pteditor_stats);
   pr_info("Removed.\n");
 }
 
@@ -56,6 +56,231 @@ typedef struct {
     size_t valid;
 } ptedit_entry_t;
 
+/**
+ * Structure to resolve multiple virtual addresses of one process at once
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Number of addresses to resolve */
+    size_t count;
+    /** Virtual addresses to resolve */
+    size_t* vaddrs;
+    /** Resolved page-table entries, one per address */
+    ptedit_entry_t* entries;
+} ptedit_resolve_batch_t;
+
+/**
+ * Structure to update the page-table entries of multiple virtual addresses of one process at once
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Number of entries to update */
+    size_t count;
+    /** New page-table entries, the virtual address and valid mask of each entry select what to update */
+    ptedit_entry_t* entries;
+} ptedit_update_batch_t;
+
+/**
+ * Structure to resolve all pages of a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Resolved page-table entries, one per page in the range */
+    ptedit_entry_t* entries;
+} ptedit_resolve_range_args_t;
+
+/**
+ * Structure to atomically set and clear bits in all PTEs of a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Bits to set in every PTE */
+    size_t set_mask;
+    /** Bits to clear in every PTE */
+    size_t clear_mask;
+    /** PTEDITOR_MODIFY_* flags */
+    size_t flags;
+} ptedit_pte_modify_range_t;
+
+/** Modify non-present PTEs as well (including empty ones), e.g., to set the present bit again */
+#define PTEDITOR_MODIFY_NON_PRESENT (1<<0)
+
+/** Clear the accessed bits of all harvested entries */
+#define PTEDITOR_HARVEST_CLEAR_ACCESSED (1<<0)
+/** Clear the dirty bits of all harvested entries */
+#define PTEDITOR_HARVEST_CLEAR_DIRTY (1<<1)
+/** Skip page tables whose upper-level entry has a clear accessed bit (x86 only), reporting their pages as not accessed and clean */
+#define PTEDITOR_HARVEST_SKIP_OLD (1<<2)
+
+/**
+ * Structure to collect the accessed and dirty bits of all pages in a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Flags (PTEDITOR_HARVEST_*) */
+    size_t flags;
+    /** Bitmap receiving one bit per page (bit i % 8 of byte i / 8) which is set if the page was accessed, can be NULL */
+    unsigned char* accessed;
+    /** Bitmap receiving one bit per page which is set if the page is dirty, can be NULL */
+    unsigned char* dirty;
+} ptedit_harvest_t;
+
+/**
+ * Structure to atomically compare and exchange one page-table entry of a virtual address of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Virtual address */
+    size_t vaddr;
+    /** The level of the entry (one of PTEDIT_VALID_MASK_*) */
+    size_t level;
+    /** The expected value of the entry */
+    size_t expected;
+    /** The new value of the entry, only written if the entry has the expected value */
+    size_t desired;
+    /** The value of the entry observed before the exchange */
+    size_t observed;
+} ptedit_cmpxchg_t;
+
+/**
+ * Structure receiving the TLB invalidation statistics of a committed transaction
+ */
+typedef struct {
+    /** Number of TLB invalidations requested during the transaction */
+    size_t requested;
+    /** Number of TLB invalidations issued on commit */
+    size_t issued;
+} ptedit_txn_t;
+
+/**
+ * Structure to lock a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+} ptedit_lock_range_t;
+
+/** Resolve was served while holding the mmap lock */
+#define PTEDITOR_RESOLVE_PATH_LOCKED 0
+/** Resolve was served while holding only the lock of the VMA (per-VMA locking) */
+#define PTEDITOR_RESOLVE_PATH_VMA 1
+/** Resolve was served without any lock with interrupts disabled (own process only) */
+#define PTEDITOR_RESOLVE_PATH_IRQ 2
+/** Number of resolve paths */
+#define PTEDITOR_RESOLVE_PATHS 3
+
+/**
+ * Structure receiving the number of resolves served by each path
+ */
+typedef struct {
+    /** Number of resolves per path (indexed by PTEDITOR_RESOLVE_PATH_*) */
+    size_t path[PTEDITOR_RESOLVE_PATHS];
+} ptedit_resolve_stats_t;
+
+/** Benchmark resolving all entries of an address */
+#define PTEDITOR_BENCH_RESOLVE 0
+/** Benchmark atomically writing back the (unchanged) PTE of an address, including the TLB invalidation */
+#define PTEDITOR_BENCH_UPDATE 1
+/** Benchmark invalidating the TLB for an address */
+#define PTEDITOR_BENCH_FLUSH 2
+
+/**
+ * Structure to run an operation repeatedly inside the kernel, receiving the cycles spent in each phase
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Virtual address */
+    size_t vaddr;
+    /** Operation (one of PTEDITOR_BENCH_*) */
+    size_t op;
+    /** Number of iterations */
+    size_t iterations;
+    /** Cycles spent finding the address space of the process (summed over all iterations) */
+    size_t lookup;
+    /** Cycles spent acquiring and releasing the mmap lock */
+    size_t lock;
+    /** Cycles spent walking (and for updates, writing) the page tables */
+    size_t walk;
+    /** Cycles spent invalidating the TLB */
+    size_t flush;
+} ptedit_bench_t;
+
+/** Number of entries of the command ring (power of two) */
+#define PTEDITOR_RING_ENTRIES 512
+/** The command ring is processed by a kernel thread, it resolves pids in the pid namespace of the process that set up the ring */
+#define PTEDITOR_RING_SQPOLL 1
+/** The polling thread sleeps and has to be woken with PTEDITOR_IOCTL_CMD_RING_ENTER */
+#define PTEDITOR_RING_NEED_WAKEUP 1
+
+/**
+ * Structure containing one request of the command ring
+ */
+typedef struct {
+    /** The request (PTEDITOR_IOCTL_CMD_VM_RESOLVE, PTEDITOR_IOCTL_CMD_VM_UPDATE, or PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID) */
+    size_t cmd;
+    /** The return value of the request */
+    size_t result;
+    /** The entry to resolve or update, or the address to invalidate */
+    ptedit_entry_t entry;
+} ptedit_ring_entry_t;
+
+/**
+ * Command ring shared between user space and the kernel module (mapped at offset 0 of the device)
+ */
+typedef struct {
+    /** Number of submitted requests, written by user space */
+    size_t tail;
+    size_t pad0[7];
+    /** Number of completed requests, written by the kernel */
+    size_t head;
+    /** PTEDITOR_RING_NEED_WAKEUP if the polling thread sleeps */
+    size_t flags;
+    size_t pad1[6];
+    /** The requests, request n is in entry n % PTEDITOR_RING_ENTRIES */
+    ptedit_ring_entry_t entries[PTEDITOR_RING_ENTRIES];
+} ptedit_ring_t;
+
+/** Offset of the device at which the page tables of the range set with PTEDITOR_IOCTL_CMD_PT_MAP are mapped */
+#define PTEDITOR_MMAP_PAGE_TABLES 0x100000
+
+/**
+ * Structure to define the virtual address range whose last-level page tables are mapped
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the range in bytes */
+    size_t length;
+} ptedit_pt_map_t;
+
+/** Maximum number of entries (or pages) per batch ioctl */
+#define PTEDITOR_BATCH_MAX 65536
+
 /**
  * Structure to read/write physical pages
  */
@@ -79,6 +304,114 @@ typedef struct {
 __pragma(pack(pop))
 #endif
 
+/**
+ * Structure describing a run of physically contiguous pages and the buffer they are copied from/to
+ */
+typedef struct {
+    /** Page-frame number of the first page */
+    size_t pfn;
+    /** Number of pages */
+    size_t count;
+    /** Buffer of count pages */
+    unsigned char* buffer;
+} ptedit_phys_iovec_t;
+
+/**
+ * Structure to read/write multiple runs of physical pages at once
+ */
+typedef struct {
+    /** Number of runs */
+    size_t count;
+    /** The runs, consecutive runs that are contiguous in physical memory and in the buffer are copied at once */
+    ptedit_phys_iovec_t* iov;
+} ptedit_phys_batch_t;
+
+/**
+ * Structure to copy, fill, or clear multiple physical pages in the kernel
+ */
+typedef struct {
+    /** Number of pages */
+    size_t count;
+    /** Page-frame numbers of the destination pages */
+    size_t* dst;
+    /** Page-frame numbers of the source pages (copy only) */
+    size_t* src;
+    /** 64-bit pattern the pages are filled with (fill only) */
+    size_t pattern;
+} ptedit_phys_op_t;
+
+/** Magic number at the start of a page-table dump ("PTEDDUMP") */
+#define PTEDITOR_DUMP_MAGIC 0x504d554444455450ull
+/** Version of the page-table dump format */
+#define PTEDITOR_DUMP_VERSION 1
+
+/**
+ * Header of a page-table dump, followed by one ptedit_dump_record_t per present entry
+ */
+typedef struct {
+    /** PTEDITOR_DUMP_MAGIC */
+    size_t magic;
+    /** PTEDITOR_DUMP_VERSION */
+    size_t version;
+    /** Size of one record in bytes */
+    size_t record_size;
+    /** Process id */
+    size_t pid;
+} ptedit_dump_header_t;
+
+/**
+ * One present page-table entry of a page-table dump, the entries of a level precede the entries of the next lower level they refer to
+ */
+typedef struct {
+    /** First virtual address mapped by the entry */
+    size_t vaddr;
+    /** Raw value of the entry */
+    size_t entry;
+    /** Level of the entry (one of PTEDIT_VALID_MASK_*) */
+    size_t level;
+} ptedit_dump_record_t;
+
+/** Entries of the range were unmapped (e.g., munmap) */
+#define PTEDITOR_WATCH_UNMAP 0
+/** Entries of the range were cleared (e.g., swapped out, MADV_DONTNEED, page collapsed) */
+#define PTEDITOR_WATCH_CLEAR 1
+/** Permissions of the range changed (e.g., mprotect, NUMA balancing) */
+#define PTEDITOR_WATCH_PROTECTION 2
+/** Soft-dirty bits of the range were cleared */
+#define PTEDITOR_WATCH_SOFT_DIRTY 3
+/** Pages of the range were migrated */
+#define PTEDITOR_WATCH_MIGRATE 4
+/** Entries of the range changed for any other reason */
+#define PTEDITOR_WATCH_OTHER 5
+/** The address space exited, no further records follow */
+#define PTEDITOR_WATCH_RELEASE 6
+/** Records were lost, all entries of the watched range have to be considered changed */
+#define PTEDITOR_WATCH_OVERFLOW 7
+
+/**
+ * Structure to watch a virtual address range of one process for page-table changes
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+} ptedit_watch_t;
+
+/**
+ * One page-table change of a watched range, adjacent changes of the same kind are merged
+ */
+typedef struct {
+    /** First virtual address of the changed range */
+    size_t start;
+    /** End (exclusive) of the changed range */
+    size_t end;
+    /** Kind of change (one of PTEDITOR_WATCH_*) */
+    size_t event;
+} ptedit_watch_record_t;
+
 
 /**
  * Structure to get/set the root of paging
@@ -98,6 +431,51 @@ typedef struct {
     void* address;
 } ptedit_invalidate_tlb_args_t;
 
+/** Invalidate only on the current CPU */
+#define PTEDITOR_TLB_SCOPE_LOCAL 0
+/** Invalidate on all CPUs that (may) have used the address space of the process */
+#define PTEDITOR_TLB_SCOPE_MM 1
+/** Invalidate the entire TLB of all CPUs */
+#define PTEDITOR_TLB_SCOPE_ALL 2
+
+/**
+ * One virtual address range of one process invalidated by a coalesced shootdown
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t start;
+    /** End (exclusive) of the virtual address range */
+    size_t end;
+} ptedit_shootdown_range_t;
+
+/**
+ * Structure to invalidate the TLB for multiple ranges of multiple processes with a single request
+ */
+typedef struct {
+    /** Number of ranges */
+    size_t count;
+    /** Ranges to invalidate */
+    ptedit_shootdown_range_t* ranges;
+} ptedit_shootdown_t;
+
+/**
+ * Structure to invalidate the TLB for a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t start;
+    /** End (exclusive) of the virtual address range */
+    size_t end;
+    /** Size of the pages mapping the range (page size, PMD size, or PUD size), 0 for the page size */
+    size_t stride;
+    /** Where the TLB is invalidated (one of PTEDITOR_TLB_SCOPE_*) */
+    size_t scope;
+} ptedit_invalidate_tlb_range_t;
+
 #define PTEDIT_VALID_MASK_PGD (1<<0)
 #define PTEDIT_VALID_MASK_P4D (1<<1)
 #define PTEDIT_VALID_MASK_PUD (1<<2)
@@ -151,6 +529,84 @@ typedef struct {
 
 #define PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID \
   _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 14, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 15, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 16, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_RESOLVE_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 17, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_PTE_MODIFY_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 18, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_CMPXCHG \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 19, size_t)
+
+#define PTEDITOR_IOCTL_CMD_TXN_BEGIN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 20, size_t)
+
+#define PTEDITOR_IOCTL_CMD_TXN_COMMIT \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 21, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 22, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RESOLVE_STATS \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 23, size_t)
+
+#define PTEDITOR_IOCTL_CMD_ATTACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 24, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RING_SETUP \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 25, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RING_ENTER \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 26, size_t)
+
+#define PTEDITOR_IOCTL_CMD_PT_MAP \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 27, size_t)
+
+#define PTEDITOR_IOCTL_CMD_READ_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 28, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WRITE_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 29, size_t)
+
+#define PTEDITOR_IOCTL_CMD_COPY_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 30, size_t)
+
+#define PTEDITOR_IOCTL_CMD_FILL_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 31, size_t)
+
+#define PTEDITOR_IOCTL_CMD_CLEAR_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 32, size_t)
+
+#define PTEDITOR_IOCTL_CMD_DUMP_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 33, size_t)
+
+#define PTEDITOR_IOCTL_CMD_PTE_FILE_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 34, size_t)
+
+#define PTEDITOR_IOCTL_CMD_HARVEST \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 35, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WATCH_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 36, size_t)
+
+#define PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 37, size_t)
+
+#define PTEDITOR_IOCTL_CMD_SHOOTDOWN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 38, size_t)
+
+#define PTEDITOR_IOCTL_CMD_BENCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 39, size_t)
+
+#define PTEDITOR_IOCTL_CMD_DETACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 40, size_t)
 #else
 #define PTEDITOR_READ_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #define PTEDITOR_WRITE_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_READ_DATA)
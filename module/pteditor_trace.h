@@ -0,0 +1,55 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pteditor
+
+#if !defined(PTEDITOR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define PTEDITOR_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/mm_types.h>
+#include "pteditor.h"
+
+/*
+ * Page-table entries written by the module, identified by the address space and the global id of
+ * its process (not the pid of the request, which is 0 for the own process), e.g., for an audit trail with
+ *   trace-cmd record -e pteditor
+ *   perf record -e pteditor:pteditor_update
+ * The tracepoints are static keys, i.e., they only cost a no-op while disabled.
+ */
+TRACE_EVENT(pteditor_update,
+  TP_PROTO(struct mm_struct* mm, pid_t tgid, unsigned long vaddr, int level, u64 old, u64 new),
+  TP_ARGS(mm, tgid, vaddr, level, old, new),
+  TP_STRUCT__entry(
+    __field(const void*, mm)
+    __field(pid_t, tgid)
+    __field(unsigned long, vaddr)
+    __field(int, level)
+    __field(u64, old)
+    __field(u64, new)
+  ),
+  TP_fast_assign(
+    __entry->mm = mm;
+    __entry->tgid = tgid;
+    __entry->vaddr = vaddr;
+    __entry->level = level;
+    __entry->old = old;
+    __entry->new = new;
+  ),
+  TP_printk("mm=%p tgid=%d vaddr=0x%lx level=%s old=0x%llx new=0x%llx",
+            __entry->mm, __entry->tgid, __entry->vaddr,
+            __print_symbolic(__entry->level,
+                             { PTEDIT_VALID_MASK_PGD, "pgd" },
+                             { PTEDIT_VALID_MASK_P4D, "p4d" },
+                             { PTEDIT_VALID_MASK_PUD, "pud" },
+                             { PTEDIT_VALID_MASK_PMD, "pmd" },
+                             { PTEDIT_VALID_MASK_PTE, "pte" }),
+            __entry->old, __entry->new)
+);
+
+#endif
+
+/* The header is not in the kernel's include path, but next to the module */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pteditor_trace
+#include <trace/define_trace.h>
@@ -37,6 +37,12 @@ static size_t ptedit_pfn_multiply = 4096;
 static size_t ptedit_entry_size = sizeof(size_t);
 static size_t ptedit_paging_root;
 static unsigned char* ptedit_vmem;
+#if defined(LINUX)
+static ptedit_ring_t* ptedit_ring;
+static size_t ptedit_ring_tail;
+// Number of polls for a completion of the ring before entering the kernel
+#define PTEDIT_RING_SPINS (1 << 20)
+#endif
 
 typedef struct {
     int has_pgd, has_p4d, has_pud, has_pmd, has_pt;
@@ -50,6 +56,7 @@ static ptedit_paging_definition_t ptedit_paging_definition;
 // ---------------------------------------------------------------------------
 ptedit_fnc ptedit_resolve_t ptedit_resolve;
 ptedit_fnc ptedit_update_t ptedit_update;
+ptedit_fnc ptedit_resolve_range_t ptedit_resolve_range;
 
 
 // ---------------------------------------------------------------------------
@@ -66,6 +73,30 @@ ptedit_fnc ptedit_entry_t ptedit_resolve_kernel(void* address, pid_t pid) {
     return vm;
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_resolve_range_kernel(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    size_t count = 0;
+#if defined(LINUX)
+    ptedit_resolve_range_args_t range;
+    size_t start = (size_t)address & ~((size_t)ptedit_pagesize - 1);
+    size_t end = (size_t)address + length;
+    size_t chunk = (size_t)PTEDITOR_BATCH_MAX * ptedit_pagesize;
+    for (range.vaddr = start; range.vaddr < end; range.vaddr += chunk) {
+        range.pid = (size_t)pid;
+        range.length = (end - range.vaddr > chunk) ? chunk : (end - range.vaddr);
+        range.entries = entries + count;
+        long resolved = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE_RANGE, (size_t)&range);
+        if (resolved < 0) {
+            break;
+        }
+        count += resolved;
+    }
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+    return count;
+}
+
 // ---------------------------------------------------------------------------
 typedef size_t(*ptedit_phys_read_t)(size_t);
 typedef void(*ptedit_phys_write_t)(size_t, size_t);
@@ -210,6 +241,93 @@ static ptedit_entry_t ptedit_resolve_user_ext(void* address, pid_t pid, ptedit_p
 }
 
 
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user_ext(void* address, size_t length, pid_t pid, ptedit_entry_t* entries, ptedit_phys_read_t deref) {
+    size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
+    root = root & ~1;
+
+    // PGD and PT always exist, folded levels are copied from the level above
+    int has[5] = { 1, ptedit_paging_definition.has_p4d, ptedit_paging_definition.has_pud, ptedit_paging_definition.has_pmd, 1 };
+    int bits[5] = { ptedit_paging_definition.pgd_entries, ptedit_paging_definition.p4d_entries, ptedit_paging_definition.pud_entries, ptedit_paging_definition.pmd_entries, ptedit_paging_definition.pt_entries };
+    size_t valid_mask[5] = { PTEDIT_VALID_MASK_PGD, PTEDIT_VALID_MASK_P4D, PTEDIT_VALID_MASK_PUD, PTEDIT_VALID_MASK_PMD, PTEDIT_VALID_MASK_PTE };
+    int shift[5], level, last, depth = 0;
+    size_t entry[5], tag[5];
+
+    shift[4] = ptedit_paging_definition.page_offset;
+    for (level = 3; level >= 0; level--) {
+        shift[level] = shift[level + 1] + bits[level + 1];
+    }
+
+    size_t pagesize = 1ull << ptedit_paging_definition.page_offset;
+    size_t start = (size_t)address & ~(pagesize - 1);
+    size_t end = ((size_t)address + length + pagesize - 1) & ~(pagesize - 1);
+    size_t addr, next;
+
+    ptedit_entry_t resolved;
+    size_t* fields[5] = { &resolved.pgd, &resolved.p4d, &resolved.pud, &resolved.pmd, &resolved.pte };
+
+    for (addr = start; addr < end; addr = next) {
+        memset(&resolved, 0, sizeof(resolved));
+        resolved.pid = (size_t)pid;
+
+        if (root) {
+            // entries of upper levels are reused as long as the address is covered by them
+            for (level = 0; level < depth; level++) {
+                if ((addr >> shift[level]) != tag[level]) break;
+            }
+            for (depth = level; depth < 5; depth++) {
+                if (has[depth]) {
+                    size_t table = depth ? (size_t)ptedit_cast(entry[depth - 1], ptedit_pgd_t).pfn * ptedit_pfn_multiply : root;
+                    entry[depth] = deref(table + ((addr >> shift[depth]) % (1ull << bits[depth])) * ptedit_entry_size);
+                }
+                else {
+                    entry[depth] = entry[depth - 1];
+                }
+                tag[depth] = addr >> shift[depth];
+                if (ptedit_cast(entry[depth], ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
+                    break;
+                }
+#if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
+                if (depth == 3 && ptedit_cast(entry[depth], ptedit_pmd_t).size) {
+                    break;
+                }
+#endif
+            }
+
+            last = (depth < 5) ? depth : 4;
+            for (level = 0; level <= last; level++) {
+                if (level == 0 && ptedit_cast(entry[0], ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
+                    break;
+                }
+                *fields[level] = entry[level];
+                if (has[level]) {
+                    resolved.valid |= valid_mask[level];
+                }
+            }
+        }
+
+        // all pages of an unmapped region (or huge page) share the same entries
+        if (!root) {
+            next = end;
+        }
+        else if (depth < 5) {
+            next = ((addr >> shift[depth]) + 1) << shift[depth];
+            if (next > end || next <= addr) {
+                next = end;
+            }
+        }
+        else {
+            next = addr + pagesize;
+        }
+        for (; addr < next; addr += pagesize) {
+            resolved.vaddr = addr;
+            entries[(addr - start) / pagesize] = resolved;
+        }
+    }
+    return (end - start) / pagesize;
+}
+
+
 // ---------------------------------------------------------------------------
 static ptedit_entry_t ptedit_resolve_user(void* address, pid_t pid) {
     return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread);
@@ -222,6 +340,18 @@ static ptedit_entry_t ptedit_resolve_user_map(void* address, pid_t pid) {
 }
 
 
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    return ptedit_resolve_range_user_ext(address, length, pid, entries, ptedit_phys_read_pread);
+}
+
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user_map(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    return ptedit_resolve_range_user_ext(address, length, pid, entries, ptedit_phys_read_map);
+}
+
+
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* vm) {
     vm->vaddr = (size_t)address;
@@ -233,6 +363,51 @@ ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* v
 #endif
 }
 
+#if defined(LINUX)
+// ---------------------------------------------------------------------------
+// Submits a request and waits for its completion, returns -1 if the ring is not processed anymore.
+// Not thread-safe: the ring has a single submitter, i.e., requests must not be submitted concurrently.
+static size_t ptedit_ring_submit(size_t cmd, ptedit_entry_t* entry) {
+    size_t tail = ptedit_ring_tail++;
+    size_t spins = 0;
+    ptedit_ring_entry_t* slot = &ptedit_ring->entries[tail % PTEDITOR_RING_ENTRIES];
+    slot->cmd = cmd;
+    slot->entry = *entry;
+    __atomic_store_n(&ptedit_ring->tail, tail + 1, __ATOMIC_RELEASE);
+    // the polling thread sets the flag before it checks the tail for the last time
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ptedit_ring->flags, __ATOMIC_RELAXED) & PTEDITOR_RING_NEED_WAKEUP) {
+        ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_ENTER, 0);
+    }
+    while (__atomic_load_n(&ptedit_ring->head, __ATOMIC_ACQUIRE) <= tail) {
+        // the polling thread might not be running (e.g., if it is not scheduled), entering the kernel wakes it or reports that it ended
+        if (++spins == PTEDIT_RING_SPINS) {
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_ENTER, 0) < 0) return (size_t)-1;
+            spins = 0;
+        }
+    }
+    *entry = slot->entry;
+    return slot->result;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc ptedit_entry_t ptedit_resolve_kernel_ring(void* address, pid_t pid) {
+    ptedit_entry_t vm;
+    memset(&vm, 0, sizeof(vm));
+    vm.vaddr = (size_t)address;
+    vm.pid = (size_t)pid;
+    ptedit_ring_submit(PTEDITOR_IOCTL_CMD_VM_RESOLVE, &vm);
+    return vm;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_kernel_ring(void* address, pid_t pid, ptedit_entry_t* vm) {
+    vm->vaddr = (size_t)address;
+    vm->pid = (size_t)pid;
+    ptedit_ring_submit(PTEDITOR_IOCTL_CMD_VM_UPDATE, vm);
+}
+#endif
+
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_phys_write_t pset) {
     ptedit_entry_t current = ptedit_resolve(address, pid);
@@ -281,14 +456,347 @@ ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t*
 // ---------------------------------------------------------------------------
 static void ptedit_update_user(void* address, pid_t pid, ptedit_entry_t* vm) {
     ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_pwrite);
-    ptedit_invalidate_tlb_pid(pid, address);
 }
 
 
 // ---------------------------------------------------------------------------
 static void ptedit_update_user_map(void* address, pid_t pid, ptedit_entry_t* vm) {
     ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_map);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_resolve_batch(void** addresses, size_t count, pid_t pid, ptedit_entry_t* entries) {
+    size_t i;
+#if defined(LINUX)
+    if (ptedit_resolve == ptedit_resolve_kernel) {
+        ptedit_resolve_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            batch.pid = (size_t)pid;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            batch.vaddrs = (size_t*)(addresses + i);
+            batch.entries = entries + i;
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH, (size_t)&batch)) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        entries[i] = ptedit_resolve(addresses[i], pid);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_update_batch(ptedit_entry_t* entries, size_t count, pid_t pid) {
+    size_t i;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_update_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            batch.pid = (size_t)pid;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            batch.entries = entries + i;
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH, (size_t)&batch)) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        ptedit_update((void*)entries[i].vaddr, pid, &entries[i]);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_entry_address_user(void* address, pid_t pid, int level) {
+    int has[5] = { 1, ptedit_paging_definition.has_p4d, ptedit_paging_definition.has_pud, ptedit_paging_definition.has_pmd, 1 };
+    int bits[5] = { ptedit_paging_definition.pgd_entries, ptedit_paging_definition.p4d_entries, ptedit_paging_definition.pud_entries, ptedit_paging_definition.pmd_entries, ptedit_paging_definition.pt_entries };
+    int shift = ptedit_paging_definition.page_offset, i, index;
+
+    ptedit_entry_t vm = ptedit_resolve(address, pid);
+    size_t values[5] = { vm.pgd, vm.p4d, vm.pud, vm.pmd, vm.pte };
+    size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
+    root = root & ~1;
+
+    for (index = 0; index < 5 && level != (1 << index); index++);
+    if (index == 5 || !root) return 0;
+    // folded levels are stored in the level above
+    while (index > 0 && !has[index]) index--;
+    if (!(vm.valid & (1 << index))) return 0;
+    for (i = 4; i > index; i--) shift += bits[i];
+
+    size_t table = index ? (size_t)ptedit_cast(values[index - 1], ptedit_pgd_t).pfn * ptedit_pfn_multiply : root;
+    return table + (((size_t)address >> shift) % (1ull << bits[index])) * ptedit_entry_size;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_cmpxchg(void* address, pid_t pid, int level, size_t expected, size_t desired, size_t* observed) {
+    size_t value;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_cmpxchg_t xchg;
+        xchg.pid = (size_t)pid;
+        xchg.vaddr = (size_t)address;
+        xchg.level = (size_t)level;
+        xchg.expected = expected;
+        xchg.desired = desired;
+        if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_CMPXCHG, (size_t)&xchg)) {
+            return -1;
+        }
+        if (observed) *observed = xchg.observed;
+        return xchg.observed != expected;
+    }
+#endif
+    size_t entry = ptedit_entry_address_user(address, pid, level);
+    if (!entry) return -1;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_user_map) {
+        value = __sync_val_compare_and_swap((size_t*)(ptedit_vmem + entry), expected, desired);
+    }
+    else
+#endif
+    {
+        // not atomic, physical memory can only be read and written
+        value = ptedit_phys_read_pread(entry);
+        if (value == expected) {
+            ptedit_phys_write_pwrite(entry, desired);
+        }
+    }
+    if (observed) *observed = value;
+    if (value != expected) return 1;
     ptedit_invalidate_tlb_pid(pid, address);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int ptedit_pte_modify_range_flags(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask, size_t flags) {
+    int changed = 0;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_t modify;
+        modify.pid = (size_t)pid;
+        modify.vaddr = (size_t)address;
+        modify.length = length;
+        modify.set_mask = set_mask;
+        modify.clear_mask = clear_mask;
+        modify.flags = flags;
+        return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_PTE_MODIFY_RANGE, (size_t)&modify);
+    }
+#endif
+    size_t start = (size_t)address & ~((size_t)ptedit_pagesize - 1);
+    size_t pages = ((size_t)address + length - start + ptedit_pagesize - 1) / ptedit_pagesize;
+    ptedit_entry_t* entries = (ptedit_entry_t*)malloc(pages * sizeof(ptedit_entry_t));
+    size_t i;
+    if (!entries) return -1;
+    pages = ptedit_resolve_range(address, length, pid, entries);
+    for (i = 0; i < pages; i++) {
+        size_t pte = (entries[i].pte & ~clear_mask) | set_mask;
+        if (!(entries[i].valid & PTEDIT_VALID_MASK_PTE) || pte == entries[i].pte) continue;
+        if (!(flags & PTEDITOR_MODIFY_NON_PRESENT) && ptedit_cast(entries[i].pte, ptedit_pte_t).present != PTEDIT_PAGE_PRESENT) continue;
+        entries[i].pte = pte;
+        entries[i].valid = PTEDIT_VALID_MASK_PTE;
+        entries[changed++] = entries[i];
+    }
+    ptedit_update_batch(entries, changed, pid);
+    free(entries);
+    return changed;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_pte_modify_range(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask) {
+    return ptedit_pte_modify_range_flags(address, length, pid, set_mask, clear_mask, 0);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_lock_range(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_lock_range_t range;
+    range.pid = (size_t)pid;
+    range.vaddr = (size_t)address;
+    range.length = length;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE, (size_t)&range) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_unlock_range() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UNLOCK, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_get_resolve_stats(ptedit_resolve_stats_t* stats) {
+#if defined(LINUX)
+    if (!stats) return -1;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RESOLVE_STATS, (size_t)stats) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_bench(void* address, pid_t pid, int op, size_t iterations, ptedit_bench_t* result) {
+#if defined(LINUX)
+    if (!result) return -1;
+    result->pid = (size_t)pid;
+    result->vaddr = (size_t)address;
+    result->op = (size_t)op;
+    result->iterations = iterations;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_BENCH, (size_t)result) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_page_table_span(void* address, size_t length) {
+    size_t region = (size_t)ptedit_pagesize / sizeof(size_t) * ptedit_pagesize;
+    size_t start = (size_t)address & ~(region - 1);
+    return ((size_t)address + length - 1 - start) / region + 1;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t* ptedit_map_page_tables(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_pt_map_t range;
+    size_t entries = (size_t)ptedit_pagesize / sizeof(size_t);
+    char* tables;
+    range.pid = (size_t)pid;
+    range.vaddr = (size_t)address;
+    range.length = length;
+    if (!length || ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_PT_MAP, (size_t)&range)) return NULL;
+    tables = (char*)mmap(NULL, ptedit_page_table_span(address, length) * ptedit_pagesize, PROT_READ | PROT_WRITE, MAP_SHARED, ptedit_fd, PTEDITOR_MMAP_PAGE_TABLES);
+    if (tables == MAP_FAILED) return NULL;
+    return (size_t*)tables + (((size_t)address / ptedit_pagesize) & (entries - 1));
+#else
+    NO_WINDOWS_SUPPORT;
+    return NULL;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_unmap_page_tables(size_t* ptes, void* address, size_t length) {
+#if defined(LINUX)
+    char* tables = (char*)((size_t)ptes & ~((size_t)ptedit_pagesize - 1));
+    if (!ptes) return;
+    munmap(tables, ptedit_page_table_span(address, length) * ptedit_pagesize);
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_dump_open(pid_t pid) {
+#if defined(LINUX)
+    int fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_DUMP_OPEN, (size_t)pid);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc long ptedit_harvest(void* address, size_t length, pid_t pid, size_t flags, unsigned char* accessed, unsigned char* dirty) {
+#if defined(LINUX)
+    ptedit_harvest_t harvest;
+    long young;
+    harvest.pid = (size_t)pid;
+    harvest.vaddr = (size_t)address;
+    harvest.length = length;
+    harvest.flags = flags;
+    harvest.accessed = accessed;
+    harvest.dirty = dirty;
+    young = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_HARVEST, (size_t)&harvest);
+    return (young < 0) ? -1 : young;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_watch_open(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_watch_t watch;
+    int fd;
+    watch.pid = (size_t)pid;
+    watch.vaddr = (size_t)address;
+    watch.length = length;
+    fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_WATCH_OPEN, (size_t)&watch);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_pte_file_open(pid_t pid) {
+#if defined(LINUX)
+    int fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_PTE_FILE_OPEN, (size_t)pid);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_attach(pid_t pid) {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_ATTACH, (size_t)pid) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_detach() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_DETACH, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_txn_begin() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_TXN_BEGIN, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_txn_commit() {
+#if defined(LINUX)
+    ptedit_txn_t result;
+    if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_TXN_COMMIT, (size_t)&result)) {
+        return 0;
+    }
+    return result.requested - result.issued;
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
 }
 
 // ---------------------------------------------------------------------------
@@ -503,6 +1011,10 @@ ptedit_fnc int ptedit_init() {
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_cleanup() {
 #if defined(LINUX)
+    if (ptedit_ring) {
+        munmap(ptedit_ring, sizeof(ptedit_ring_t));
+        ptedit_ring = NULL;
+    }
     if (ptedit_fd >= 0) {
         close(ptedit_fd);
     }
@@ -521,6 +1033,29 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
 #if defined(LINUX)
         ptedit_resolve = ptedit_resolve_kernel;
         ptedit_update = ptedit_update_kernel;
+        ptedit_resolve_range = ptedit_resolve_range_kernel;
+#else
+        fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: PTEditor implementation not supported on Windows");
+#endif
+    }
+    else if (implementation == PTEDIT_IMPL_KERNEL_RING) {
+#if defined(LINUX)
+        if (!ptedit_ring) {
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_SETUP, PTEDITOR_RING_SQPOLL)) {
+                fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET " Error: Could not set up the command ring\n");
+                return;
+            }
+            ptedit_ring = (ptedit_ring_t*)mmap(NULL, sizeof(ptedit_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, ptedit_fd, 0);
+            if (ptedit_ring == MAP_FAILED) {
+                ptedit_ring = NULL;
+                fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET " Error: Could not map the command ring\n");
+                return;
+            }
+            ptedit_ring_tail = 0;
+        }
+        ptedit_resolve = ptedit_resolve_kernel_ring;
+        ptedit_update = ptedit_update_kernel_ring;
+        ptedit_resolve_range = ptedit_resolve_range_kernel;
 #else
         fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: PTEditor implementation not supported on Windows");
 #endif
@@ -528,12 +1063,14 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
     else if (implementation == PTEDIT_IMPL_USER_PREAD) {
         ptedit_resolve = ptedit_resolve_user;
         ptedit_update = ptedit_update_user;
+        ptedit_resolve_range = ptedit_resolve_range_user;
         ptedit_paging_root = ptedit_get_paging_root(0);
     }
     else if (implementation == PTEDIT_IMPL_USER) {
 #if defined(LINUX)
         ptedit_resolve = ptedit_resolve_user_map;
         ptedit_update = ptedit_update_user_map;
+        ptedit_resolve_range = ptedit_resolve_range_user_map;
         ptedit_paging_root = ptedit_get_paging_root(0);
         if (!ptedit_vmem) {
             ptedit_vmem = (unsigned char*)mmap(NULL, 32ull << 30ull, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, ptedit_umem, 0);
@@ -548,6 +1085,18 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
     }
 }
 
+#if defined(LINUX) && defined(IORING_SETUP_SQE128)
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_uring_prep(struct io_uring_sqe* sqe, unsigned int cmd, void* request) {
+    __u64 arg = (size_t)request;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = ptedit_fd;
+    sqe->cmd_op = cmd;
+    memcpy(sqe->cmd, &arg, sizeof(arg));
+}
+#endif
+
 
 // ---------------------------------------------------------------------------
 ptedit_fnc int ptedit_get_pagesize() {
@@ -610,6 +1159,97 @@ ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content) {
 #endif
 }
 
+// ---------------------------------------------------------------------------
+static size_t ptedit_transfer_physical_pages(ptedit_phys_iovec_t* iov, size_t count, int write) {
+    size_t pages = 0;
+#if defined(LINUX)
+    size_t i;
+    if (ptedit_umem > 0) {
+        for (i = 0; i < count; i++) {
+            size_t size = iov[i].count * ptedit_pagesize;
+            ssize_t copied = write ? pwrite(ptedit_umem, iov[i].buffer, size, iov[i].pfn * ptedit_pagesize)
+                                   : pread(ptedit_umem, iov[i].buffer, size, iov[i].pfn * ptedit_pagesize);
+            if (copied != (ssize_t)size) return 0;
+            pages += iov[i].count;
+        }
+    }
+    else {
+        ptedit_phys_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            long copied;
+            batch.iov = iov + i;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            copied = ioctl(ptedit_fd, write ? PTEDITOR_IOCTL_CMD_WRITE_PAGES : PTEDITOR_IOCTL_CMD_READ_PAGES, (size_t)&batch);
+            if (copied < 0) return 0;
+            pages += copied;
+        }
+    }
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+    return pages;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_read_physical_pages(ptedit_phys_iovec_t* iov, size_t count) {
+    return ptedit_transfer_physical_pages(iov, count, 0);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_write_physical_pages(ptedit_phys_iovec_t* iov, size_t count) {
+    return ptedit_transfer_physical_pages(iov, count, 1);
+}
+
+// ---------------------------------------------------------------------------
+#if defined(LINUX)
+static size_t ptedit_physical_op(unsigned long cmd, size_t* dst, size_t* src, size_t count, size_t pattern) {
+    size_t pages = 0;
+    ptedit_phys_op_t op;
+    size_t i;
+    op.pattern = pattern;
+    for (i = 0; i < count; i += op.count) {
+        long done;
+        op.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+        op.dst = dst + i;
+        op.src = src ? src + i : NULL;
+        done = ioctl(ptedit_fd, cmd, (size_t)&op);
+        if (done < 0) return 0;
+        pages += done;
+    }
+    return pages;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_copy_physical_pages(size_t* dst, size_t* src, size_t count) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_COPY_PAGES, dst, src, count, 0);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_fill_physical_pages(size_t* pfns, size_t count, size_t pattern) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_FILL_PAGES, pfns, NULL, count, pattern);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_clear_physical_pages(size_t* pfns, size_t count) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_CLEAR_PAGES, pfns, NULL, count, 0);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
 
 // ---------------------------------------------------------------------------
 size_t ptedit_get_paging_root(pid_t pid) {
@@ -660,6 +1300,41 @@ ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address) {
 #endif
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_invalidate_tlb_range(pid_t pid, void* address, size_t length, size_t stride, int scope) {
+#if defined(LINUX)
+    ptedit_invalidate_tlb_range_t range;
+    range.pid = (size_t)pid;
+    range.start = (size_t)address;
+    range.end = (size_t)address + length;
+    range.stride = stride;
+    range.scope = (size_t)scope;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE, (size_t)&range) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_shootdown(ptedit_shootdown_range_t* ranges, size_t count) {
+#if defined(LINUX)
+    ptedit_shootdown_t shootdown;
+    shootdown.count = count;
+    shootdown.ranges = ranges;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_SHOOTDOWN, (size_t)&shootdown) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_invalidate_tlb_mm(pid_t pid, int scope) {
+    // a range larger than the flush threshold invalidates the entire address space
+    return ptedit_invalidate_tlb_range(pid, NULL, ~(size_t)0, 0, scope);
+}
+
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_invalidate_tlb(void* address) {
     // we do not directly call ptedit_invalidate_tlb_pid to ensure that the old
@@ -897,6 +1572,12 @@ ptedit_fnc void ptedit_full_serializing_barrier() {
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit) {
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_flags(address, 1, pid, 1ull << bit, 0, PTEDITOR_MODIFY_NON_PRESENT);
+        return;
+    }
+#endif
     ptedit_entry_t vm = ptedit_resolve(address, pid);
     if (!(vm.valid & PTEDIT_VALID_MASK_PTE)) return;
     vm.pte |= (1ull << bit);
@@ -906,6 +1587,12 @@ ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit) {
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_pte_clear_bit(void* address, pid_t pid, int bit) {
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_flags(address, 1, pid, 0, 1ull << bit, PTEDITOR_MODIFY_NON_PRESENT);
+        return;
+    }
+#endif
     ptedit_entry_t vm = ptedit_resolve(address, pid);
     if (!(vm.valid & PTEDIT_VALID_MASK_PTE)) return;
     vm.pte &= ~(1ull << bit);
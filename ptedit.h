@@ -11,6 +11,11 @@ extern "C" {
 
 #include "module/pteditor.h"
 #include <sys/types.h>
+#if defined(LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
 
 #if defined(WINDOWS)
 typedef size_t pid_t;
@@ -30,6 +35,8 @@ typedef size_t pid_t;
 #define PTEDIT_IMPL_USER_PREAD   1
 /** Use the user-space implemenation that maps the physical memory into user space to resolve and update paging structures */
 #define PTEDIT_IMPL_USER         2
+/** Use the kernel to resolve and update paging structures, requests are passed through a command ring polled by a kernel thread (no syscalls in steady state, not thread-safe) */
+#define PTEDIT_IMPL_KERNEL_RING  3
 
 /**
  * The bits in a page-table entry
@@ -197,11 +204,27 @@ ptedit_fnc void ptedit_cleanup();
 /**
  * Switch between kernel and user-space implementation
  *
- * @param[in] implementation The implementation to use, either PTEDIT_IMPL_KERNEL, PTEDIT_IMPL_USER, or PTEDIT_IMPL_USER_PREAD
+ * @param[in] implementation The implementation to use, either PTEDIT_IMPL_KERNEL, PTEDIT_IMPL_KERNEL_RING, PTEDIT_IMPL_USER, or PTEDIT_IMPL_USER_PREAD
  *
  */
 ptedit_fnc void ptedit_use_implementation(int implementation);
 
+#if defined(LINUX) && defined(IORING_SETUP_SQE128)
+/**
+ * Prepares an io_uring submission queue entry that executes a request of the kernel module asynchronously.
+ * Supported requests are PTEDITOR_IOCTL_CMD_VM_RESOLVE, PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH, PTEDITOR_IOCTL_CMD_VM_UPDATE,
+ * PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH, PTEDITOR_IOCTL_CMD_READ_PAGE, PTEDITOR_IOCTL_CMD_WRITE_PAGE, and PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID.
+ * The request structure must stay valid until the completion is reaped, the result of the completion is the return value of the corresponding ioctl.
+ * The entry is cleared, i.e., user_data has to be set afterwards.
+ *
+ * @param[out] sqe The submission queue entry
+ * @param[in] cmd The request (one of PTEDITOR_IOCTL_CMD_*)
+ * @param[in] request The request structure, e.g., a ptedit_entry_t for PTEDITOR_IOCTL_CMD_VM_RESOLVE
+ *
+ */
+ptedit_fnc void ptedit_uring_prep(struct io_uring_sqe* sqe, unsigned int cmd, void* request);
+#endif
+
 /** @} */
 
 
@@ -217,6 +240,7 @@ ptedit_fnc void ptedit_use_implementation(int implementation);
 
 typedef ptedit_entry_t(*ptedit_resolve_t)(void*, pid_t);
 typedef void (*ptedit_update_t)(void*, pid_t, ptedit_entry_t*);
+typedef size_t (*ptedit_resolve_range_t)(void*, size_t, pid_t, ptedit_entry_t*);
 
 
 /**
@@ -240,6 +264,195 @@ extern ptedit_fnc ptedit_resolve_t ptedit_resolve;
  */
 extern ptedit_fnc ptedit_update_t ptedit_update;
 
+/**
+ * Resolves the page-table entries of all levels for every page of a virtual address range of a given process.
+ * The range is walked in a single pass, i.e., page tables shared by consecutive pages are only read once.
+ * Pages within an unmapped region or a huge page receive the same entries.
+ *
+ * @param[in] address The start of the virtual address range (rounded down to a page boundary)
+ * @param[in] length The length of the range in bytes (rounded up to a page boundary)
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] entries An array with one structure per page in the range receiving the page-table entries of all levels
+ *
+ * @return The number of pages resolved
+ */
+extern ptedit_fnc ptedit_resolve_range_t ptedit_resolve_range;
+
+/**
+ * Resolves the page-table entries of all levels for multiple virtual addresses of a given process.
+ * With the kernel implementation, all addresses are resolved with a single request to the kernel module.
+ *
+ * @param[in] addresses The virtual addresses to resolve
+ * @param[in] count The number of addresses
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] entries An array of count structures receiving the page-table entries of all levels
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_resolve_batch(void** addresses, size_t count, pid_t pid, ptedit_entry_t* entries);
+
+/**
+ * Updates one or more page-table entries for multiple virtual addresses of a given process.
+ * With the kernel implementation, all entries are updated with a single request to the kernel module,
+ * followed by a single TLB flush covering all updated addresses.
+ *
+ * @param[in] entries An array of structures containing the virtual address, the values for the page-table entries, and a bitmask indicating which entries to update
+ * @param[in] count The number of entries
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_update_batch(ptedit_entry_t* entries, size_t count, pid_t pid);
+
+/**
+ * Atomically replaces one page-table entry of a virtual address of a given process if it has the expected value.
+ * The TLB is flushed if the entry was replaced.
+ * Entries that the kernel or the hardware changed concurrently (e.g., accessed/dirty bits) are never overwritten.
+ * A retry loop using the observed value replaces locking the entire address space (::PTEDITOR_IOCTL_CMD_VM_LOCK).
+ * With the pread implementation, the compare and the exchange are not atomic.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] level The level of the entry (one of PTEDIT_VALID_MASK_*)
+ * @param[in] expected The expected value of the entry
+ * @param[in] desired The new value of the entry
+ * @param[out] observed The value of the entry before the exchange (can be NULL)
+ *
+ * @return 0 if the entry was replaced, 1 if the entry did not have the expected value, -1 on failure
+ */
+ptedit_fnc int ptedit_cmpxchg(void* address, pid_t pid, int level, size_t expected, size_t desired, size_t* observed);
+
+/**
+ * Locks a virtual address range of a given process such that its updates do not race with changes of its mappings (e.g., munmap, mprotect, or migration).
+ * No lock is held while the range is locked, i.e., page faults and changes of other mappings are not blocked.
+ * Instead, a change of the range waits for running updates of the range, and updates wait for running changes.
+ * An update of the range fails with errno EAGAIN if the range changed since it was last resolved, as the entries might be stale.
+ * Until the range is unlocked, only entries within the range can be updated with the kernel implementation,
+ * and every entry is updated while holding the corresponding page-table lock.
+ * Only one range can be locked at a time. Requires Linux 5.0 with CONFIG_MMU_NOTIFIER.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure (e.g., if the range is not mapped entirely or a range is already locked)
+ */
+ptedit_fnc int ptedit_lock_range(void* address, size_t length, pid_t pid);
+
+/**
+ * Unlocks the virtual address range locked with ptedit_lock_range.
+ *
+ * @return 0 on success, -1 if no range is locked
+ */
+ptedit_fnc int ptedit_unlock_range();
+
+/**
+ * Retrieves how many resolves (ptedit_resolve with the kernel implementation) on this file descriptor were served by each path.
+ * Resolves of the own process are served without any lock, resolves of other processes only lock the VMA if the kernel supports per-VMA locks.
+ * Only resolves of addresses without VMA or within a locked address space fall back to the mmap lock.
+ *
+ * @param[out] stats The number of resolves per path (indexed by PTEDITOR_RESOLVE_PATH_*)
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_get_resolve_stats(ptedit_resolve_stats_t* stats);
+
+/**
+ * Runs an operation repeatedly inside the kernel and measures the cycles spent in each phase (lookup of the process, mmap lock, page walk, TLB invalidation).
+ * In contrast to timing the library functions, this excludes the cost of entering and leaving the kernel and of copying the results.
+ * An update atomically writes the current PTE back unchanged under the page-table lock.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The process id (0 for own process)
+ * @param[in] op The operation (one of PTEDITOR_BENCH_*)
+ * @param[in] iterations The number of iterations
+ * @param[out] result The cycles of each phase, summed over all iterations
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_bench(void* address, pid_t pid, int op, size_t iterations, ptedit_bench_t* result);
+
+/**
+ * Opens a stream of all present page-table entries of a given process.
+ * Reading from the returned file descriptor yields a ptedit_dump_header_t followed by one ptedit_dump_record_t per present entry of every level,
+ * ordered by virtual address, with every entry preceding the entries of the next lower level it refers to.
+ * The page tables are walked by the kernel while the stream is read, the stream can also be spliced (e.g., with sendfile) to a file.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_dump_open(pid_t pid);
+
+/**
+ * Opens a random-access file of the raw leaf entries of a given process, similar to /proc/pid/pagemap.
+ * The 8 bytes at offset (vaddr / page size) * 8 are the entry mapping vaddr (PTE, or PMD/PUD for huge pages), 0 if there is none.
+ * Writing (e.g., with pwrite) replaces the PTEs that differ from the written values, with a single TLB invalidation per write.
+ * Offsets and lengths have to be multiples of 8. A changed entry without a page table (unmapped or huge page) ends the write short before it (ENOENT if it is the first).
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_pte_file_open(pid_t pid);
+
+/**
+ * Watches a virtual address range of a given process for page-table changes made by the kernel (e.g., migration, swapping, or unmapping).
+ * Reading from the returned file descriptor yields one ptedit_watch_record_t per change once it is complete, the file descriptor can be polled.
+ * Caches of resolved entries only have to re-resolve the reported ranges, or the whole range on PTEDITOR_WATCH_OVERFLOW.
+ * Requires Linux 5.0 with CONFIG_MMU_NOTIFIER.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_watch_open(void* address, size_t length, pid_t pid);
+
+/**
+ * Attaches to a process until it is detached or the library is cleaned up.
+ * All later requests of the kernel implementation for this pid use the attached address space without looking up the process again.
+ * The address space is only pinned while a request runs, requests fail as for any other pid once the process exited.
+ * Only one process can be attached at a time.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure (e.g., if the process does not exist or a process is already attached)
+ */
+ptedit_fnc int ptedit_attach(pid_t pid);
+
+/**
+ * Detaches from the process attached with `ptedit_attach`.
+ *
+ * @return 0 on success, -1 on failure (e.g., if no process is attached)
+ */
+ptedit_fnc int ptedit_detach();
+
+/**
+ * Maps the last-level page tables of a virtual address range of a given process into the own address space.
+ * The PTEs can then be read and written directly, only flushing the TLB after writing requires the kernel module.
+ * The page tables stay allocated while they are mapped, but they are only used by the process as long as the range is not unmapped.
+ * The kernel implementation is required, and the range must not contain unmapped regions or huge pages.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return The PTEs of the range, i.e., entry i is the PTE of the i-th page of the range, NULL on failure
+ */
+ptedit_fnc size_t* ptedit_map_page_tables(void* address, size_t length, pid_t pid);
+
+/**
+ * Unmaps page tables mapped with ptedit_map_page_tables.
+ *
+ * @param[in] ptes The PTEs returned by ptedit_map_page_tables
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ *
+ */
+ptedit_fnc void ptedit_unmap_page_tables(size_t* ptes, void* address, size_t length);
+
 /**
  * Sets a bit directly in the PTE of an address.
  *
@@ -260,6 +473,41 @@ ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit);
  */
 ptedit_fnc void ptedit_pte_clear_bit(void* address, pid_t pid, int bit);
 
+/**
+ * Sets and clears bits in the PTEs of all pages in a virtual address range.
+ * Every PTE is replaced by (PTE & ~clear_mask) | set_mask. Non-present PTEs (including empty ones) and pages mapped by huge pages are not modified.
+ * With the kernel implementation, all PTEs are modified atomically with a single request to the kernel module,
+ * followed by a single TLB flush covering all modified pages.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] set_mask The bits to set (e.g., 1ull << PTEDIT_PAGE_BIT_NX)
+ * @param[in] clear_mask The bits to clear
+ *
+ * @return The number of modified PTEs, -1 on failure
+ */
+ptedit_fnc int ptedit_pte_modify_range(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask);
+
+/**
+ * Collects the accessed and dirty bits of all pages in a virtual address range with a single request to the kernel module.
+ * Bit i % 8 of byte i / 8 of a bitmap belongs to the i-th page of the range, pages mapped by huge pages report the bits of the huge page.
+ * If the bits are cleared, they are cleared atomically, followed by a single TLB flush covering all modified pages.
+ * Cleared dirty bits are moved to the page first (such that writeback does not miss them) and are flushed per page table before it is unlocked.
+ * With PTEDITOR_HARVEST_SKIP_OLD, page tables whose upper-level accessed bit is clear are not walked (x86 only),
+ * which is exact if every harvest of the range clears the accessed and dirty bits.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] flags The flags (PTEDITOR_HARVEST_CLEAR_ACCESSED, PTEDITOR_HARVEST_CLEAR_DIRTY, PTEDITOR_HARVEST_SKIP_OLD)
+ * @param[out] accessed Bitmap of accessed pages with one bit per page, can be NULL
+ * @param[out] dirty Bitmap of dirty pages with one bit per page, can be NULL
+ *
+ * @return The number of accessed pages, -1 on failure
+ */
+ptedit_fnc long ptedit_harvest(void* address, size_t length, pid_t pid, size_t flags, unsigned char* accessed, unsigned char* dirty);
+
 /**
  * Returns the value of a bit directly from the PTE of an address.
  *
@@ -578,6 +826,60 @@ ptedit_fnc void ptedit_read_physical_page(size_t pfn, char* buffer);
  */
 ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content);
 
+/**
+ * Retrieves the content of multiple runs of physically contiguous pages.
+ * With the kernel module, all runs are copied with a single request, and consecutive runs that are contiguous in physical memory and in the buffers are copied at once.
+ *
+ * @param[in] iov The runs of pages and the buffers receiving their content
+ * @param[in] count The number of runs
+ *
+ * @return The number of pages read, 0 on failure
+ */
+ptedit_fnc size_t ptedit_read_physical_pages(ptedit_phys_iovec_t* iov, size_t count);
+
+/**
+ * Replaces the content of multiple runs of physically contiguous pages.
+ * With the kernel module, all runs are copied with a single request, and consecutive runs that are contiguous in physical memory and in the buffers are copied at once.
+ *
+ * @param[in] iov The runs of pages and the buffers containing their new content
+ * @param[in] count The number of runs
+ *
+ * @return The number of pages written, 0 on failure
+ */
+ptedit_fnc size_t ptedit_write_physical_pages(ptedit_phys_iovec_t* iov, size_t count);
+
+/**
+ * Copies physical pages to other physical pages without moving their content through user space.
+ *
+ * @param[in] dst The page-frame numbers (PFNs) of the destination pages
+ * @param[in] src The page-frame numbers (PFNs) of the source pages
+ * @param[in] count The number of pages
+ *
+ * @return The number of pages copied, 0 on failure
+ */
+ptedit_fnc size_t ptedit_copy_physical_pages(size_t* dst, size_t* src, size_t count);
+
+/**
+ * Fills physical pages with a 64-bit pattern without moving their content through user space.
+ *
+ * @param[in] pfns The page-frame numbers (PFNs) of the pages
+ * @param[in] count The number of pages
+ * @param[in] pattern The pattern
+ *
+ * @return The number of pages filled, 0 on failure
+ */
+ptedit_fnc size_t ptedit_fill_physical_pages(size_t* pfns, size_t count, size_t pattern);
+
+/**
+ * Zeroes physical pages without moving their content through user space.
+ *
+ * @param[in] pfns The page-frame numbers (PFNs) of the pages
+ * @param[in] count The number of pages
+ *
+ * @return The number of pages zeroed, 0 on failure
+ */
+ptedit_fnc size_t ptedit_clear_physical_pages(size_t* pfns, size_t count);
+
 /**
  * Map a physical address range.
  *
@@ -647,6 +949,45 @@ ptedit_fnc void ptedit_invalidate_tlb(void* address);
   */
 ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address);
 
+ /**
+  * Invalidates the TLB for a virtual address range (belonging to the specified pid) with a given stride and scope.
+  * The scope is either the current CPU (PTEDITOR_TLB_SCOPE_LOCAL, own process only on x86), all CPUs that used the
+  * address space of the process (PTEDITOR_TLB_SCOPE_MM), or the entire TLB of all CPUs (PTEDITOR_TLB_SCOPE_ALL).
+  * Ranges with many pages invalidate the entire address space instead.
+  *
+  * @param[in] pid The pid of the process (0 for own process)
+  * @param[in] address The start of the virtual address range
+  * @param[in] length The length of the range in bytes
+  * @param[in] stride The size of the pages mapping the range (4 KB, 2 MB, or 1 GB on x86), 0 for the page size
+  * @param[in] scope The scope (one of PTEDITOR_TLB_SCOPE_*)
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_invalidate_tlb_range(pid_t pid, void* address, size_t length, size_t stride, int scope);
+
+ /**
+  * Invalidates the TLB for the entire address space of the specified pid with a given scope.
+  *
+  * @param[in] pid The pid of the process (0 for own process)
+  * @param[in] scope The scope (one of PTEDITOR_TLB_SCOPE_*)
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_invalidate_tlb_mm(pid_t pid, int scope);
+
+ /**
+  * Invalidates the TLB for multiple virtual address ranges of (possibly) multiple processes with a single request.
+  * On x86, every process is flushed once over the span of its ranges, interrupting only the CPUs that used its address space.
+  * On ARM, the invalidations are broadcast and share a single barrier.
+  * While a transaction is open, the ranges are only recorded.
+  *
+  * @param[in] ranges The ranges (pid, start, and exclusive end) to invalidate
+  * @param[in] count The number of ranges
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_shootdown(ptedit_shootdown_range_t* ranges, size_t count);
+
  /**
   * Change the method used for flushing the TLB (either kernel or custom function)
   *
@@ -656,6 +997,22 @@ ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address);
   */
 ptedit_fnc int ptedit_switch_tlb_invalidation(int implementation);
 
+ /**
+  * Begins a transaction of page-table updates.
+  * Until the transaction is committed, TLB invalidations (of all implementations and processes) are only recorded.
+  *
+  * @return 0 on success, -1 on failure (e.g., if a transaction is already open)
+  */
+ptedit_fnc int ptedit_txn_begin();
+
+ /**
+  * Commits a transaction of page-table updates.
+  * The recorded TLB invalidations are sorted and merged, and every affected process is flushed once over the span of its ranges (on ARM, the invalidations share a single barrier).
+  *
+  * @return The number of TLB invalidations that were avoided
+  */
+ptedit_fnc size_t ptedit_txn_commit();
+
 /**
  * A full serializing barrier which stops everything.
  *
@@ -58,6 +58,231 @@ typedef struct {
     size_t valid;
 } ptedit_entry_t;
 
+/**
+ * Structure to resolve multiple virtual addresses of one process at once
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Number of addresses to resolve */
+    size_t count;
+    /** Virtual addresses to resolve */
+    size_t* vaddrs;
+    /** Resolved page-table entries, one per address */
+    ptedit_entry_t* entries;
+} ptedit_resolve_batch_t;
+
+/**
+ * Structure to update the page-table entries of multiple virtual addresses of one process at once
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Number of entries to update */
+    size_t count;
+    /** New page-table entries, the virtual address and valid mask of each entry select what to update */
+    ptedit_entry_t* entries;
+} ptedit_update_batch_t;
+
+/**
+ * Structure to resolve all pages of a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Resolved page-table entries, one per page in the range */
+    ptedit_entry_t* entries;
+} ptedit_resolve_range_args_t;
+
+/**
+ * Structure to atomically set and clear bits in all PTEs of a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Bits to set in every PTE */
+    size_t set_mask;
+    /** Bits to clear in every PTE */
+    size_t clear_mask;
+    /** PTEDITOR_MODIFY_* flags */
+    size_t flags;
+} ptedit_pte_modify_range_t;
+
+/** Modify non-present PTEs as well (including empty ones), e.g., to set the present bit again */
+#define PTEDITOR_MODIFY_NON_PRESENT (1<<0)
+
+/** Clear the accessed bits of all harvested entries */
+#define PTEDITOR_HARVEST_CLEAR_ACCESSED (1<<0)
+/** Clear the dirty bits of all harvested entries */
+#define PTEDITOR_HARVEST_CLEAR_DIRTY (1<<1)
+/** Skip page tables whose upper-level entry has a clear accessed bit (x86 only), reporting their pages as not accessed and clean */
+#define PTEDITOR_HARVEST_SKIP_OLD (1<<2)
+
+/**
+ * Structure to collect the accessed and dirty bits of all pages in a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+    /** Flags (PTEDITOR_HARVEST_*) */
+    size_t flags;
+    /** Bitmap receiving one bit per page (bit i % 8 of byte i / 8) which is set if the page was accessed, can be NULL */
+    unsigned char* accessed;
+    /** Bitmap receiving one bit per page which is set if the page is dirty, can be NULL */
+    unsigned char* dirty;
+} ptedit_harvest_t;
+
+/**
+ * Structure to atomically compare and exchange one page-table entry of a virtual address of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Virtual address */
+    size_t vaddr;
+    /** The level of the entry (one of PTEDIT_VALID_MASK_*) */
+    size_t level;
+    /** The expected value of the entry */
+    size_t expected;
+    /** The new value of the entry, only written if the entry has the expected value */
+    size_t desired;
+    /** The value of the entry observed before the exchange */
+    size_t observed;
+} ptedit_cmpxchg_t;
+
+/**
+ * Structure receiving the TLB invalidation statistics of a committed transaction
+ */
+typedef struct {
+    /** Number of TLB invalidations requested during the transaction */
+    size_t requested;
+    /** Number of TLB invalidations issued on commit */
+    size_t issued;
+} ptedit_txn_t;
+
+/**
+ * Structure to lock a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+} ptedit_lock_range_t;
+
+/** Resolve was served while holding the mmap lock */
+#define PTEDITOR_RESOLVE_PATH_LOCKED 0
+/** Resolve was served while holding only the lock of the VMA (per-VMA locking) */
+#define PTEDITOR_RESOLVE_PATH_VMA 1
+/** Resolve was served without any lock with interrupts disabled (own process only) */
+#define PTEDITOR_RESOLVE_PATH_IRQ 2
+/** Number of resolve paths */
+#define PTEDITOR_RESOLVE_PATHS 3
+
+/**
+ * Structure receiving the number of resolves served by each path
+ */
+typedef struct {
+    /** Number of resolves per path (indexed by PTEDITOR_RESOLVE_PATH_*) */
+    size_t path[PTEDITOR_RESOLVE_PATHS];
+} ptedit_resolve_stats_t;
+
+/** Benchmark resolving all entries of an address */
+#define PTEDITOR_BENCH_RESOLVE 0
+/** Benchmark atomically writing back the (unchanged) PTE of an address, including the TLB invalidation */
+#define PTEDITOR_BENCH_UPDATE 1
+/** Benchmark invalidating the TLB for an address */
+#define PTEDITOR_BENCH_FLUSH 2
+
+/**
+ * Structure to run an operation repeatedly inside the kernel, receiving the cycles spent in each phase
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Virtual address */
+    size_t vaddr;
+    /** Operation (one of PTEDITOR_BENCH_*) */
+    size_t op;
+    /** Number of iterations */
+    size_t iterations;
+    /** Cycles spent finding the address space of the process (summed over all iterations) */
+    size_t lookup;
+    /** Cycles spent acquiring and releasing the mmap lock */
+    size_t lock;
+    /** Cycles spent walking (and for updates, writing) the page tables */
+    size_t walk;
+    /** Cycles spent invalidating the TLB */
+    size_t flush;
+} ptedit_bench_t;
+
+/** Number of entries of the command ring (power of two) */
+#define PTEDITOR_RING_ENTRIES 512
+/** The command ring is processed by a kernel thread, it resolves pids in the pid namespace of the process that set up the ring */
+#define PTEDITOR_RING_SQPOLL 1
+/** The polling thread sleeps and has to be woken with PTEDITOR_IOCTL_CMD_RING_ENTER */
+#define PTEDITOR_RING_NEED_WAKEUP 1
+
+/**
+ * Structure containing one request of the command ring
+ */
+typedef struct {
+    /** The request (PTEDITOR_IOCTL_CMD_VM_RESOLVE, PTEDITOR_IOCTL_CMD_VM_UPDATE, or PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID) */
+    size_t cmd;
+    /** The return value of the request */
+    size_t result;
+    /** The entry to resolve or update, or the address to invalidate */
+    ptedit_entry_t entry;
+} ptedit_ring_entry_t;
+
+/**
+ * Command ring shared between user space and the kernel module (mapped at offset 0 of the device)
+ */
+typedef struct {
+    /** Number of submitted requests, written by user space */
+    size_t tail;
+    size_t pad0[7];
+    /** Number of completed requests, written by the kernel */
+    size_t head;
+    /** PTEDITOR_RING_NEED_WAKEUP if the polling thread sleeps */
+    size_t flags;
+    size_t pad1[6];
+    /** The requests, request n is in entry n % PTEDITOR_RING_ENTRIES */
+    ptedit_ring_entry_t entries[PTEDITOR_RING_ENTRIES];
+} ptedit_ring_t;
+
+/** Offset of the device at which the page tables of the range set with PTEDITOR_IOCTL_CMD_PT_MAP are mapped */
+#define PTEDITOR_MMAP_PAGE_TABLES 0x100000
+
+/**
+ * Structure to define the virtual address range whose last-level page tables are mapped
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the range in bytes */
+    size_t length;
+} ptedit_pt_map_t;
+
+/** Maximum number of entries (or pages) per batch ioctl */
+#define PTEDITOR_BATCH_MAX 65536
+
 /**
  * Structure to read/write physical pages
  */
@@ -81,6 +306,114 @@ typedef struct {
 __pragma(pack(pop))
 #endif
 
+/**
+ * Structure describing a run of physically contiguous pages and the buffer they are copied from/to
+ */
+typedef struct {
+    /** Page-frame number of the first page */
+    size_t pfn;
+    /** Number of pages */
+    size_t count;
+    /** Buffer of count pages */
+    unsigned char* buffer;
+} ptedit_phys_iovec_t;
+
+/**
+ * Structure to read/write multiple runs of physical pages at once
+ */
+typedef struct {
+    /** Number of runs */
+    size_t count;
+    /** The runs, consecutive runs that are contiguous in physical memory and in the buffer are copied at once */
+    ptedit_phys_iovec_t* iov;
+} ptedit_phys_batch_t;
+
+/**
+ * Structure to copy, fill, or clear multiple physical pages in the kernel
+ */
+typedef struct {
+    /** Number of pages */
+    size_t count;
+    /** Page-frame numbers of the destination pages */
+    size_t* dst;
+    /** Page-frame numbers of the source pages (copy only) */
+    size_t* src;
+    /** 64-bit pattern the pages are filled with (fill only) */
+    size_t pattern;
+} ptedit_phys_op_t;
+
+/** Magic number at the start of a page-table dump ("PTEDDUMP") */
+#define PTEDITOR_DUMP_MAGIC 0x504d554444455450ull
+/** Version of the page-table dump format */
+#define PTEDITOR_DUMP_VERSION 1
+
+/**
+ * Header of a page-table dump, followed by one ptedit_dump_record_t per present entry
+ */
+typedef struct {
+    /** PTEDITOR_DUMP_MAGIC */
+    size_t magic;
+    /** PTEDITOR_DUMP_VERSION */
+    size_t version;
+    /** Size of one record in bytes */
+    size_t record_size;
+    /** Process id */
+    size_t pid;
+} ptedit_dump_header_t;
+
+/**
+ * One present page-table entry of a page-table dump, the entries of a level precede the entries of the next lower level they refer to
+ */
+typedef struct {
+    /** First virtual address mapped by the entry */
+    size_t vaddr;
+    /** Raw value of the entry */
+    size_t entry;
+    /** Level of the entry (one of PTEDIT_VALID_MASK_*) */
+    size_t level;
+} ptedit_dump_record_t;
+
+/** Entries of the range were unmapped (e.g., munmap) */
+#define PTEDITOR_WATCH_UNMAP 0
+/** Entries of the range were cleared (e.g., swapped out, MADV_DONTNEED, page collapsed) */
+#define PTEDITOR_WATCH_CLEAR 1
+/** Permissions of the range changed (e.g., mprotect, NUMA balancing) */
+#define PTEDITOR_WATCH_PROTECTION 2
+/** Soft-dirty bits of the range were cleared */
+#define PTEDITOR_WATCH_SOFT_DIRTY 3
+/** Pages of the range were migrated */
+#define PTEDITOR_WATCH_MIGRATE 4
+/** Entries of the range changed for any other reason */
+#define PTEDITOR_WATCH_OTHER 5
+/** The address space exited, no further records follow */
+#define PTEDITOR_WATCH_RELEASE 6
+/** Records were lost, all entries of the watched range have to be considered changed */
+#define PTEDITOR_WATCH_OVERFLOW 7
+
+/**
+ * Structure to watch a virtual address range of one process for page-table changes
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t vaddr;
+    /** Length of the virtual address range */
+    size_t length;
+} ptedit_watch_t;
+
+/**
+ * One page-table change of a watched range, adjacent changes of the same kind are merged
+ */
+typedef struct {
+    /** First virtual address of the changed range */
+    size_t start;
+    /** End (exclusive) of the changed range */
+    size_t end;
+    /** Kind of change (one of PTEDITOR_WATCH_*) */
+    size_t event;
+} ptedit_watch_record_t;
+
 
 /**
  * Structure to get/set the root of paging
@@ -100,6 +433,51 @@ typedef struct {
     void* address;
 } ptedit_invalidate_tlb_args_t;
 
+/** Invalidate only on the current CPU */
+#define PTEDITOR_TLB_SCOPE_LOCAL 0
+/** Invalidate on all CPUs that (may) have used the address space of the process */
+#define PTEDITOR_TLB_SCOPE_MM 1
+/** Invalidate the entire TLB of all CPUs */
+#define PTEDITOR_TLB_SCOPE_ALL 2
+
+/**
+ * One virtual address range of one process invalidated by a coalesced shootdown
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t start;
+    /** End (exclusive) of the virtual address range */
+    size_t end;
+} ptedit_shootdown_range_t;
+
+/**
+ * Structure to invalidate the TLB for multiple ranges of multiple processes with a single request
+ */
+typedef struct {
+    /** Number of ranges */
+    size_t count;
+    /** Ranges to invalidate */
+    ptedit_shootdown_range_t* ranges;
+} ptedit_shootdown_t;
+
+/**
+ * Structure to invalidate the TLB for a virtual address range of one process
+ */
+typedef struct {
+    /** Process ID */
+    size_t pid;
+    /** Start of the virtual address range */
+    size_t start;
+    /** End (exclusive) of the virtual address range */
+    size_t end;
+    /** Size of the pages mapping the range (page size, PMD size, or PUD size), 0 for the page size */
+    size_t stride;
+    /** Where the TLB is invalidated (one of PTEDITOR_TLB_SCOPE_*) */
+    size_t scope;
+} ptedit_invalidate_tlb_range_t;
+
 #define PTEDIT_VALID_MASK_PGD (1<<0)
 #define PTEDIT_VALID_MASK_P4D (1<<1)
 #define PTEDIT_VALID_MASK_PUD (1<<2)
@@ -153,6 +531,84 @@ typedef struct {
 
 #define PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID \
   _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 14, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 15, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 16, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_RESOLVE_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 17, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_PTE_MODIFY_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 18, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_CMPXCHG \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 19, size_t)
+
+#define PTEDITOR_IOCTL_CMD_TXN_BEGIN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 20, size_t)
+
+#define PTEDITOR_IOCTL_CMD_TXN_COMMIT \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 21, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 22, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RESOLVE_STATS \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 23, size_t)
+
+#define PTEDITOR_IOCTL_CMD_ATTACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 24, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RING_SETUP \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 25, size_t)
+
+#define PTEDITOR_IOCTL_CMD_RING_ENTER \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 26, size_t)
+
+#define PTEDITOR_IOCTL_CMD_PT_MAP \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 27, size_t)
+
+#define PTEDITOR_IOCTL_CMD_READ_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 28, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WRITE_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 29, size_t)
+
+#define PTEDITOR_IOCTL_CMD_COPY_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 30, size_t)
+
+#define PTEDITOR_IOCTL_CMD_FILL_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 31, size_t)
+
+#define PTEDITOR_IOCTL_CMD_CLEAR_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 32, size_t)
+
+#define PTEDITOR_IOCTL_CMD_DUMP_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 33, size_t)
+
+#define PTEDITOR_IOCTL_CMD_PTE_FILE_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 34, size_t)
+
+#define PTEDITOR_IOCTL_CMD_HARVEST \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 35, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WATCH_OPEN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 36, size_t)
+
+#define PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 37, size_t)
+
+#define PTEDITOR_IOCTL_CMD_SHOOTDOWN \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 38, size_t)
+
+#define PTEDITOR_IOCTL_CMD_BENCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 39, size_t)
+
+#define PTEDITOR_IOCTL_CMD_DETACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 40, size_t)
 #else
 #define PTEDITOR_READ_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #define PTEDITOR_WRITE_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_READ_DATA)
@@ -179,6 +635,11 @@ typedef struct {
 
 
 #include <sys/types.h>
+#if defined(LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
 
 #if defined(WINDOWS)
 typedef size_t pid_t;
@@ -198,6 +659,8 @@ typedef size_t pid_t;
 #define PTEDIT_IMPL_USER_PREAD   1
 /** Use the user-space implemenation that maps the physical memory into user space to resolve and update paging structures */
 #define PTEDIT_IMPL_USER         2
+/** Use the kernel to resolve and update paging structures, requests are passed through a command ring polled by a kernel thread (no syscalls in steady state, not thread-safe) */
+#define PTEDIT_IMPL_KERNEL_RING  3
 
 /**
  * The bits in a page-table entry
@@ -365,11 +828,27 @@ ptedit_fnc void ptedit_cleanup();
 /**
  * Switch between kernel and user-space implementation
  *
- * @param[in] implementation The implementation to use, either PTEDIT_IMPL_KERNEL, PTEDIT_IMPL_USER, or PTEDIT_IMPL_USER_PREAD
+ * @param[in] implementation The implementation to use, either PTEDIT_IMPL_KERNEL, PTEDIT_IMPL_KERNEL_RING, PTEDIT_IMPL_USER, or PTEDIT_IMPL_USER_PREAD
  *
  */
 ptedit_fnc void ptedit_use_implementation(int implementation);
 
+#if defined(LINUX) && defined(IORING_SETUP_SQE128)
+/**
+ * Prepares an io_uring submission queue entry that executes a request of the kernel module asynchronously.
+ * Supported requests are PTEDITOR_IOCTL_CMD_VM_RESOLVE, PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH, PTEDITOR_IOCTL_CMD_VM_UPDATE,
+ * PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH, PTEDITOR_IOCTL_CMD_READ_PAGE, PTEDITOR_IOCTL_CMD_WRITE_PAGE, and PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_PID.
+ * The request structure must stay valid until the completion is reaped, the result of the completion is the return value of the corresponding ioctl.
+ * The entry is cleared, i.e., user_data has to be set afterwards.
+ *
+ * @param[out] sqe The submission queue entry
+ * @param[in] cmd The request (one of PTEDITOR_IOCTL_CMD_*)
+ * @param[in] request The request structure, e.g., a ptedit_entry_t for PTEDITOR_IOCTL_CMD_VM_RESOLVE
+ *
+ */
+ptedit_fnc void ptedit_uring_prep(struct io_uring_sqe* sqe, unsigned int cmd, void* request);
+#endif
+
 /** @} */
 
 
@@ -385,6 +864,7 @@ ptedit_fnc void ptedit_use_implementation(int implementation);
 
 typedef ptedit_entry_t(*ptedit_resolve_t)(void*, pid_t);
 typedef void (*ptedit_update_t)(void*, pid_t, ptedit_entry_t*);
+typedef size_t (*ptedit_resolve_range_t)(void*, size_t, pid_t, ptedit_entry_t*);
 
 
 /**
@@ -408,6 +888,195 @@ ptedit_fnc ptedit_resolve_t ptedit_resolve;
  */
 ptedit_fnc ptedit_update_t ptedit_update;
 
+/**
+ * Resolves the page-table entries of all levels for every page of a virtual address range of a given process.
+ * The range is walked in a single pass, i.e., page tables shared by consecutive pages are only read once.
+ * Pages within an unmapped region or a huge page receive the same entries.
+ *
+ * @param[in] address The start of the virtual address range (rounded down to a page boundary)
+ * @param[in] length The length of the range in bytes (rounded up to a page boundary)
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] entries An array with one structure per page in the range receiving the page-table entries of all levels
+ *
+ * @return The number of pages resolved
+ */
+ptedit_fnc ptedit_resolve_range_t ptedit_resolve_range;
+
+/**
+ * Resolves the page-table entries of all levels for multiple virtual addresses of a given process.
+ * With the kernel implementation, all addresses are resolved with a single request to the kernel module.
+ *
+ * @param[in] addresses The virtual addresses to resolve
+ * @param[in] count The number of addresses
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] entries An array of count structures receiving the page-table entries of all levels
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_resolve_batch(void** addresses, size_t count, pid_t pid, ptedit_entry_t* entries);
+
+/**
+ * Updates one or more page-table entries for multiple virtual addresses of a given process.
+ * With the kernel implementation, all entries are updated with a single request to the kernel module,
+ * followed by a single TLB flush covering all updated addresses.
+ *
+ * @param[in] entries An array of structures containing the virtual address, the values for the page-table entries, and a bitmask indicating which entries to update
+ * @param[in] count The number of entries
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_update_batch(ptedit_entry_t* entries, size_t count, pid_t pid);
+
+/**
+ * Atomically replaces one page-table entry of a virtual address of a given process if it has the expected value.
+ * The TLB is flushed if the entry was replaced.
+ * Entries that the kernel or the hardware changed concurrently (e.g., accessed/dirty bits) are never overwritten.
+ * A retry loop using the observed value replaces locking the entire address space (::PTEDITOR_IOCTL_CMD_VM_LOCK).
+ * With the pread implementation, the compare and the exchange are not atomic.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] level The level of the entry (one of PTEDIT_VALID_MASK_*)
+ * @param[in] expected The expected value of the entry
+ * @param[in] desired The new value of the entry
+ * @param[out] observed The value of the entry before the exchange (can be NULL)
+ *
+ * @return 0 if the entry was replaced, 1 if the entry did not have the expected value, -1 on failure
+ */
+ptedit_fnc int ptedit_cmpxchg(void* address, pid_t pid, int level, size_t expected, size_t desired, size_t* observed);
+
+/**
+ * Locks a virtual address range of a given process such that its updates do not race with changes of its mappings (e.g., munmap, mprotect, or migration).
+ * No lock is held while the range is locked, i.e., page faults and changes of other mappings are not blocked.
+ * Instead, a change of the range waits for running updates of the range, and updates wait for running changes.
+ * An update of the range fails with errno EAGAIN if the range changed since it was last resolved, as the entries might be stale.
+ * Until the range is unlocked, only entries within the range can be updated with the kernel implementation,
+ * and every entry is updated while holding the corresponding page-table lock.
+ * Only one range can be locked at a time. Requires Linux 5.0 with CONFIG_MMU_NOTIFIER.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure (e.g., if the range is not mapped entirely or a range is already locked)
+ */
+ptedit_fnc int ptedit_lock_range(void* address, size_t length, pid_t pid);
+
+/**
+ * Unlocks the virtual address range locked with ptedit_lock_range.
+ *
+ * @return 0 on success, -1 if no range is locked
+ */
+ptedit_fnc int ptedit_unlock_range();
+
+/**
+ * Retrieves how many resolves (ptedit_resolve with the kernel implementation) on this file descriptor were served by each path.
+ * Resolves of the own process are served without any lock, resolves of other processes only lock the VMA if the kernel supports per-VMA locks.
+ * Only resolves of addresses without VMA or within a locked address space fall back to the mmap lock.
+ *
+ * @param[out] stats The number of resolves per path (indexed by PTEDITOR_RESOLVE_PATH_*)
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_get_resolve_stats(ptedit_resolve_stats_t* stats);
+
+/**
+ * Runs an operation repeatedly inside the kernel and measures the cycles spent in each phase (lookup of the process, mmap lock, page walk, TLB invalidation).
+ * In contrast to timing the library functions, this excludes the cost of entering and leaving the kernel and of copying the results.
+ * An update atomically writes the current PTE back unchanged under the page-table lock.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The process id (0 for own process)
+ * @param[in] op The operation (one of PTEDITOR_BENCH_*)
+ * @param[in] iterations The number of iterations
+ * @param[out] result The cycles of each phase, summed over all iterations
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_bench(void* address, pid_t pid, int op, size_t iterations, ptedit_bench_t* result);
+
+/**
+ * Opens a stream of all present page-table entries of a given process.
+ * Reading from the returned file descriptor yields a ptedit_dump_header_t followed by one ptedit_dump_record_t per present entry of every level,
+ * ordered by virtual address, with every entry preceding the entries of the next lower level it refers to.
+ * The page tables are walked by the kernel while the stream is read, the stream can also be spliced (e.g., with sendfile) to a file.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_dump_open(pid_t pid);
+
+/**
+ * Opens a random-access file of the raw leaf entries of a given process, similar to /proc/pid/pagemap.
+ * The 8 bytes at offset (vaddr / page size) * 8 are the entry mapping vaddr (PTE, or PMD/PUD for huge pages), 0 if there is none.
+ * Writing (e.g., with pwrite) replaces the PTEs that differ from the written values, with a single TLB invalidation per write.
+ * Offsets and lengths have to be multiples of 8. A changed entry without a page table (unmapped or huge page) ends the write short before it (ENOENT if it is the first).
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_pte_file_open(pid_t pid);
+
+/**
+ * Watches a virtual address range of a given process for page-table changes made by the kernel (e.g., migration, swapping, or unmapping).
+ * Reading from the returned file descriptor yields one ptedit_watch_record_t per change once it is complete, the file descriptor can be polled.
+ * Caches of resolved entries only have to re-resolve the reported ranges, or the whole range on PTEDITOR_WATCH_OVERFLOW.
+ * Requires Linux 5.0 with CONFIG_MMU_NOTIFIER.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return A file descriptor which has to be closed by the caller, -1 on failure
+ */
+ptedit_fnc int ptedit_watch_open(void* address, size_t length, pid_t pid);
+
+/**
+ * Attaches to a process until it is detached or the library is cleaned up.
+ * All later requests of the kernel implementation for this pid use the attached address space without looking up the process again.
+ * The address space is only pinned while a request runs, requests fail as for any other pid once the process exited.
+ * Only one process can be attached at a time.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return 0 on success, -1 on failure (e.g., if the process does not exist or a process is already attached)
+ */
+ptedit_fnc int ptedit_attach(pid_t pid);
+
+/**
+ * Detaches from the process attached with `ptedit_attach`.
+ *
+ * @return 0 on success, -1 on failure (e.g., if no process is attached)
+ */
+ptedit_fnc int ptedit_detach();
+
+/**
+ * Maps the last-level page tables of a virtual address range of a given process into the own address space.
+ * The PTEs can then be read and written directly, only flushing the TLB after writing requires the kernel module.
+ * The page tables stay allocated while they are mapped, but they are only used by the process as long as the range is not unmapped.
+ * The kernel implementation is required, and the range must not contain unmapped regions or huge pages.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ * @return The PTEs of the range, i.e., entry i is the PTE of the i-th page of the range, NULL on failure
+ */
+ptedit_fnc size_t* ptedit_map_page_tables(void* address, size_t length, pid_t pid);
+
+/**
+ * Unmaps page tables mapped with ptedit_map_page_tables.
+ *
+ * @param[in] ptes The PTEs returned by ptedit_map_page_tables
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ *
+ */
+ptedit_fnc void ptedit_unmap_page_tables(size_t* ptes, void* address, size_t length);
+
 /**
  * Sets a bit directly in the PTE of an address.
  *
@@ -428,6 +1097,41 @@ ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit);
  */
 ptedit_fnc void ptedit_pte_clear_bit(void* address, pid_t pid, int bit);
 
+/**
+ * Sets and clears bits in the PTEs of all pages in a virtual address range.
+ * Every PTE is replaced by (PTE & ~clear_mask) | set_mask. Non-present PTEs (including empty ones) and pages mapped by huge pages are not modified.
+ * With the kernel implementation, all PTEs are modified atomically with a single request to the kernel module,
+ * followed by a single TLB flush covering all modified pages.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] set_mask The bits to set (e.g., 1ull << PTEDIT_PAGE_BIT_NX)
+ * @param[in] clear_mask The bits to clear
+ *
+ * @return The number of modified PTEs, -1 on failure
+ */
+ptedit_fnc int ptedit_pte_modify_range(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask);
+
+/**
+ * Collects the accessed and dirty bits of all pages in a virtual address range with a single request to the kernel module.
+ * Bit i % 8 of byte i / 8 of a bitmap belongs to the i-th page of the range, pages mapped by huge pages report the bits of the huge page.
+ * If the bits are cleared, they are cleared atomically, followed by a single TLB flush covering all modified pages.
+ * Cleared dirty bits are moved to the page first (such that writeback does not miss them) and are flushed per page table before it is unlocked.
+ * With PTEDITOR_HARVEST_SKIP_OLD, page tables whose upper-level accessed bit is clear are not walked (x86 only),
+ * which is exact if every harvest of the range clears the accessed and dirty bits.
+ *
+ * @param[in] address The start of the virtual address range
+ * @param[in] length The length of the range in bytes
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] flags The flags (PTEDITOR_HARVEST_CLEAR_ACCESSED, PTEDITOR_HARVEST_CLEAR_DIRTY, PTEDITOR_HARVEST_SKIP_OLD)
+ * @param[out] accessed Bitmap of accessed pages with one bit per page, can be NULL
+ * @param[out] dirty Bitmap of dirty pages with one bit per page, can be NULL
+ *
+ * @return The number of accessed pages, -1 on failure
+ */
+ptedit_fnc long ptedit_harvest(void* address, size_t length, pid_t pid, size_t flags, unsigned char* accessed, unsigned char* dirty);
+
 /**
  * Returns the value of a bit directly from the PTE of an address.
  *
@@ -746,6 +1450,60 @@ ptedit_fnc void ptedit_read_physical_page(size_t pfn, char* buffer);
  */
 ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content);
 
+/**
+ * Retrieves the content of multiple runs of physically contiguous pages.
+ * With the kernel module, all runs are copied with a single request, and consecutive runs that are contiguous in physical memory and in the buffers are copied at once.
+ *
+ * @param[in] iov The runs of pages and the buffers receiving their content
+ * @param[in] count The number of runs
+ *
+ * @return The number of pages read, 0 on failure
+ */
+ptedit_fnc size_t ptedit_read_physical_pages(ptedit_phys_iovec_t* iov, size_t count);
+
+/**
+ * Replaces the content of multiple runs of physically contiguous pages.
+ * With the kernel module, all runs are copied with a single request, and consecutive runs that are contiguous in physical memory and in the buffers are copied at once.
+ *
+ * @param[in] iov The runs of pages and the buffers containing their new content
+ * @param[in] count The number of runs
+ *
+ * @return The number of pages written, 0 on failure
+ */
+ptedit_fnc size_t ptedit_write_physical_pages(ptedit_phys_iovec_t* iov, size_t count);
+
+/**
+ * Copies physical pages to other physical pages without moving their content through user space.
+ *
+ * @param[in] dst The page-frame numbers (PFNs) of the destination pages
+ * @param[in] src The page-frame numbers (PFNs) of the source pages
+ * @param[in] count The number of pages
+ *
+ * @return The number of pages copied, 0 on failure
+ */
+ptedit_fnc size_t ptedit_copy_physical_pages(size_t* dst, size_t* src, size_t count);
+
+/**
+ * Fills physical pages with a 64-bit pattern without moving their content through user space.
+ *
+ * @param[in] pfns The page-frame numbers (PFNs) of the pages
+ * @param[in] count The number of pages
+ * @param[in] pattern The pattern
+ *
+ * @return The number of pages filled, 0 on failure
+ */
+ptedit_fnc size_t ptedit_fill_physical_pages(size_t* pfns, size_t count, size_t pattern);
+
+/**
+ * Zeroes physical pages without moving their content through user space.
+ *
+ * @param[in] pfns The page-frame numbers (PFNs) of the pages
+ * @param[in] count The number of pages
+ *
+ * @return The number of pages zeroed, 0 on failure
+ */
+ptedit_fnc size_t ptedit_clear_physical_pages(size_t* pfns, size_t count);
+
 /**
  * Map a physical address range.
  *
@@ -815,6 +1573,45 @@ ptedit_fnc void ptedit_invalidate_tlb(void* address);
   */
 ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address);
 
+ /**
+  * Invalidates the TLB for a virtual address range (belonging to the specified pid) with a given stride and scope.
+  * The scope is either the current CPU (PTEDITOR_TLB_SCOPE_LOCAL, own process only on x86), all CPUs that used the
+  * address space of the process (PTEDITOR_TLB_SCOPE_MM), or the entire TLB of all CPUs (PTEDITOR_TLB_SCOPE_ALL).
+  * Ranges with many pages invalidate the entire address space instead.
+  *
+  * @param[in] pid The pid of the process (0 for own process)
+  * @param[in] address The start of the virtual address range
+  * @param[in] length The length of the range in bytes
+  * @param[in] stride The size of the pages mapping the range (4 KB, 2 MB, or 1 GB on x86), 0 for the page size
+  * @param[in] scope The scope (one of PTEDITOR_TLB_SCOPE_*)
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_invalidate_tlb_range(pid_t pid, void* address, size_t length, size_t stride, int scope);
+
+ /**
+  * Invalidates the TLB for the entire address space of the specified pid with a given scope.
+  *
+  * @param[in] pid The pid of the process (0 for own process)
+  * @param[in] scope The scope (one of PTEDITOR_TLB_SCOPE_*)
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_invalidate_tlb_mm(pid_t pid, int scope);
+
+ /**
+  * Invalidates the TLB for multiple virtual address ranges of (possibly) multiple processes with a single request.
+  * On x86, every process is flushed once over the span of its ranges, interrupting only the CPUs that used its address space.
+  * On ARM, the invalidations are broadcast and share a single barrier.
+  * While a transaction is open, the ranges are only recorded.
+  *
+  * @param[in] ranges The ranges (pid, start, and exclusive end) to invalidate
+  * @param[in] count The number of ranges
+  *
+  * @return 0 on success, -1 on failure
+  */
+ptedit_fnc int ptedit_shootdown(ptedit_shootdown_range_t* ranges, size_t count);
+
  /**
   * Change the method used for flushing the TLB (either kernel or custom function)
   *
@@ -824,6 +1621,22 @@ ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address);
   */
 ptedit_fnc int ptedit_switch_tlb_invalidation(int implementation);
 
+ /**
+  * Begins a transaction of page-table updates.
+  * Until the transaction is committed, TLB invalidations (of all implementations and processes) are only recorded.
+  *
+  * @return 0 on success, -1 on failure (e.g., if a transaction is already open)
+  */
+ptedit_fnc int ptedit_txn_begin();
+
+ /**
+  * Commits a transaction of page-table updates.
+  * The recorded TLB invalidations are sorted and merged, and every affected process is flushed once over the span of its ranges (on ARM, the invalidations share a single barrier).
+  *
+  * @return The number of TLB invalidations that were avoided
+  */
+ptedit_fnc size_t ptedit_txn_commit();
+
 /**
  * A full serializing barrier which stops everything.
  *
@@ -1036,6 +1849,12 @@ static size_t ptedit_pfn_multiply = 4096;
 static size_t ptedit_entry_size = sizeof(size_t);
 static size_t ptedit_paging_root;
 static unsigned char* ptedit_vmem;
+#if defined(LINUX)
+static ptedit_ring_t* ptedit_ring;
+static size_t ptedit_ring_tail;
+// Number of polls for a completion of the ring before entering the kernel
+#define PTEDIT_RING_SPINS (1 << 20)
+#endif
 
 typedef struct {
     int has_pgd, has_p4d, has_pud, has_pmd, has_pt;
@@ -1049,6 +1868,7 @@ static ptedit_paging_definition_t ptedit_paging_definition;
 // ---------------------------------------------------------------------------
 ptedit_fnc ptedit_resolve_t ptedit_resolve;
 ptedit_fnc ptedit_update_t ptedit_update;
+ptedit_fnc ptedit_resolve_range_t ptedit_resolve_range;
 
 
 // ---------------------------------------------------------------------------
@@ -1065,6 +1885,30 @@ ptedit_fnc ptedit_entry_t ptedit_resolve_kernel(void* address, pid_t pid) {
     return vm;
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_resolve_range_kernel(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    size_t count = 0;
+#if defined(LINUX)
+    ptedit_resolve_range_args_t range;
+    size_t start = (size_t)address & ~((size_t)ptedit_pagesize - 1);
+    size_t end = (size_t)address + length;
+    size_t chunk = (size_t)PTEDITOR_BATCH_MAX * ptedit_pagesize;
+    for (range.vaddr = start; range.vaddr < end; range.vaddr += chunk) {
+        range.pid = (size_t)pid;
+        range.length = (end - range.vaddr > chunk) ? chunk : (end - range.vaddr);
+        range.entries = entries + count;
+        long resolved = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE_RANGE, (size_t)&range);
+        if (resolved < 0) {
+            break;
+        }
+        count += resolved;
+    }
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+    return count;
+}
+
 // ---------------------------------------------------------------------------
 typedef size_t(*ptedit_phys_read_t)(size_t);
 typedef void(*ptedit_phys_write_t)(size_t, size_t);
@@ -1209,6 +2053,93 @@ static ptedit_entry_t ptedit_resolve_user_ext(void* address, pid_t pid, ptedit_p
 }
 
 
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user_ext(void* address, size_t length, pid_t pid, ptedit_entry_t* entries, ptedit_phys_read_t deref) {
+    size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
+    root = root & ~1;
+
+    // PGD and PT always exist, folded levels are copied from the level above
+    int has[5] = { 1, ptedit_paging_definition.has_p4d, ptedit_paging_definition.has_pud, ptedit_paging_definition.has_pmd, 1 };
+    int bits[5] = { ptedit_paging_definition.pgd_entries, ptedit_paging_definition.p4d_entries, ptedit_paging_definition.pud_entries, ptedit_paging_definition.pmd_entries, ptedit_paging_definition.pt_entries };
+    size_t valid_mask[5] = { PTEDIT_VALID_MASK_PGD, PTEDIT_VALID_MASK_P4D, PTEDIT_VALID_MASK_PUD, PTEDIT_VALID_MASK_PMD, PTEDIT_VALID_MASK_PTE };
+    int shift[5], level, last, depth = 0;
+    size_t entry[5], tag[5];
+
+    shift[4] = ptedit_paging_definition.page_offset;
+    for (level = 3; level >= 0; level--) {
+        shift[level] = shift[level + 1] + bits[level + 1];
+    }
+
+    size_t pagesize = 1ull << ptedit_paging_definition.page_offset;
+    size_t start = (size_t)address & ~(pagesize - 1);
+    size_t end = ((size_t)address + length + pagesize - 1) & ~(pagesize - 1);
+    size_t addr, next;
+
+    ptedit_entry_t resolved;
+    size_t* fields[5] = { &resolved.pgd, &resolved.p4d, &resolved.pud, &resolved.pmd, &resolved.pte };
+
+    for (addr = start; addr < end; addr = next) {
+        memset(&resolved, 0, sizeof(resolved));
+        resolved.pid = (size_t)pid;
+
+        if (root) {
+            // entries of upper levels are reused as long as the address is covered by them
+            for (level = 0; level < depth; level++) {
+                if ((addr >> shift[level]) != tag[level]) break;
+            }
+            for (depth = level; depth < 5; depth++) {
+                if (has[depth]) {
+                    size_t table = depth ? (size_t)ptedit_cast(entry[depth - 1], ptedit_pgd_t).pfn * ptedit_pfn_multiply : root;
+                    entry[depth] = deref(table + ((addr >> shift[depth]) % (1ull << bits[depth])) * ptedit_entry_size);
+                }
+                else {
+                    entry[depth] = entry[depth - 1];
+                }
+                tag[depth] = addr >> shift[depth];
+                if (ptedit_cast(entry[depth], ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
+                    break;
+                }
+#if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
+                if (depth == 3 && ptedit_cast(entry[depth], ptedit_pmd_t).size) {
+                    break;
+                }
+#endif
+            }
+
+            last = (depth < 5) ? depth : 4;
+            for (level = 0; level <= last; level++) {
+                if (level == 0 && ptedit_cast(entry[0], ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
+                    break;
+                }
+                *fields[level] = entry[level];
+                if (has[level]) {
+                    resolved.valid |= valid_mask[level];
+                }
+            }
+        }
+
+        // all pages of an unmapped region (or huge page) share the same entries
+        if (!root) {
+            next = end;
+        }
+        else if (depth < 5) {
+            next = ((addr >> shift[depth]) + 1) << shift[depth];
+            if (next > end || next <= addr) {
+                next = end;
+            }
+        }
+        else {
+            next = addr + pagesize;
+        }
+        for (; addr < next; addr += pagesize) {
+            resolved.vaddr = addr;
+            entries[(addr - start) / pagesize] = resolved;
+        }
+    }
+    return (end - start) / pagesize;
+}
+
+
 // ---------------------------------------------------------------------------
 static ptedit_entry_t ptedit_resolve_user(void* address, pid_t pid) {
     return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread);
@@ -1220,17 +2151,74 @@ static ptedit_entry_t ptedit_resolve_user_map(void* address, pid_t pid) {
     return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_map);
 }
 
-
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    return ptedit_resolve_range_user_ext(address, length, pid, entries, ptedit_phys_read_pread);
+}
+
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_resolve_range_user_map(void* address, size_t length, pid_t pid, ptedit_entry_t* entries) {
+    return ptedit_resolve_range_user_ext(address, length, pid, entries, ptedit_phys_read_map);
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* vm) {
+    vm->vaddr = (size_t)address;
+    vm->pid = (size_t)pid;
+#if defined(LINUX)
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm);
+#else 
+    NO_WINDOWS_SUPPORT
+#endif
+}
+
+#if defined(LINUX)
+// ---------------------------------------------------------------------------
+// Submits a request and waits for its completion, returns -1 if the ring is not processed anymore.
+// Not thread-safe: the ring has a single submitter, i.e., requests must not be submitted concurrently.
+static size_t ptedit_ring_submit(size_t cmd, ptedit_entry_t* entry) {
+    size_t tail = ptedit_ring_tail++;
+    size_t spins = 0;
+    ptedit_ring_entry_t* slot = &ptedit_ring->entries[tail % PTEDITOR_RING_ENTRIES];
+    slot->cmd = cmd;
+    slot->entry = *entry;
+    __atomic_store_n(&ptedit_ring->tail, tail + 1, __ATOMIC_RELEASE);
+    // the polling thread sets the flag before it checks the tail for the last time
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ptedit_ring->flags, __ATOMIC_RELAXED) & PTEDITOR_RING_NEED_WAKEUP) {
+        ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_ENTER, 0);
+    }
+    while (__atomic_load_n(&ptedit_ring->head, __ATOMIC_ACQUIRE) <= tail) {
+        // the polling thread might not be running (e.g., if it is not scheduled), entering the kernel wakes it or reports that it ended
+        if (++spins == PTEDIT_RING_SPINS) {
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_ENTER, 0) < 0) return (size_t)-1;
+            spins = 0;
+        }
+    }
+    *entry = slot->entry;
+    return slot->result;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc ptedit_entry_t ptedit_resolve_kernel_ring(void* address, pid_t pid) {
+    ptedit_entry_t vm;
+    memset(&vm, 0, sizeof(vm));
+    vm.vaddr = (size_t)address;
+    vm.pid = (size_t)pid;
+    ptedit_ring_submit(PTEDITOR_IOCTL_CMD_VM_RESOLVE, &vm);
+    return vm;
+}
+
 // ---------------------------------------------------------------------------
-ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* vm) {
+ptedit_fnc void ptedit_update_kernel_ring(void* address, pid_t pid, ptedit_entry_t* vm) {
     vm->vaddr = (size_t)address;
     vm->pid = (size_t)pid;
-#if defined(LINUX)
-    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm);
-#else 
-    NO_WINDOWS_SUPPORT
-#endif
+    ptedit_ring_submit(PTEDITOR_IOCTL_CMD_VM_UPDATE, vm);
 }
+#endif
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_phys_write_t pset) {
@@ -1280,14 +2268,347 @@ ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t*
 // ---------------------------------------------------------------------------
 static void ptedit_update_user(void* address, pid_t pid, ptedit_entry_t* vm) {
     ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_pwrite);
-    ptedit_invalidate_tlb_pid(pid, address);
 }
 
 
 // ---------------------------------------------------------------------------
 static void ptedit_update_user_map(void* address, pid_t pid, ptedit_entry_t* vm) {
     ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_map);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_resolve_batch(void** addresses, size_t count, pid_t pid, ptedit_entry_t* entries) {
+    size_t i;
+#if defined(LINUX)
+    if (ptedit_resolve == ptedit_resolve_kernel) {
+        ptedit_resolve_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            batch.pid = (size_t)pid;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            batch.vaddrs = (size_t*)(addresses + i);
+            batch.entries = entries + i;
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH, (size_t)&batch)) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        entries[i] = ptedit_resolve(addresses[i], pid);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_update_batch(ptedit_entry_t* entries, size_t count, pid_t pid) {
+    size_t i;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_update_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            batch.pid = (size_t)pid;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            batch.entries = entries + i;
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH, (size_t)&batch)) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        ptedit_update((void*)entries[i].vaddr, pid, &entries[i]);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_entry_address_user(void* address, pid_t pid, int level) {
+    int has[5] = { 1, ptedit_paging_definition.has_p4d, ptedit_paging_definition.has_pud, ptedit_paging_definition.has_pmd, 1 };
+    int bits[5] = { ptedit_paging_definition.pgd_entries, ptedit_paging_definition.p4d_entries, ptedit_paging_definition.pud_entries, ptedit_paging_definition.pmd_entries, ptedit_paging_definition.pt_entries };
+    int shift = ptedit_paging_definition.page_offset, i, index;
+
+    ptedit_entry_t vm = ptedit_resolve(address, pid);
+    size_t values[5] = { vm.pgd, vm.p4d, vm.pud, vm.pmd, vm.pte };
+    size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
+    root = root & ~1;
+
+    for (index = 0; index < 5 && level != (1 << index); index++);
+    if (index == 5 || !root) return 0;
+    // folded levels are stored in the level above
+    while (index > 0 && !has[index]) index--;
+    if (!(vm.valid & (1 << index))) return 0;
+    for (i = 4; i > index; i--) shift += bits[i];
+
+    size_t table = index ? (size_t)ptedit_cast(values[index - 1], ptedit_pgd_t).pfn * ptedit_pfn_multiply : root;
+    return table + (((size_t)address >> shift) % (1ull << bits[index])) * ptedit_entry_size;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_cmpxchg(void* address, pid_t pid, int level, size_t expected, size_t desired, size_t* observed) {
+    size_t value;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_cmpxchg_t xchg;
+        xchg.pid = (size_t)pid;
+        xchg.vaddr = (size_t)address;
+        xchg.level = (size_t)level;
+        xchg.expected = expected;
+        xchg.desired = desired;
+        if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_CMPXCHG, (size_t)&xchg)) {
+            return -1;
+        }
+        if (observed) *observed = xchg.observed;
+        return xchg.observed != expected;
+    }
+#endif
+    size_t entry = ptedit_entry_address_user(address, pid, level);
+    if (!entry) return -1;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_user_map) {
+        value = __sync_val_compare_and_swap((size_t*)(ptedit_vmem + entry), expected, desired);
+    }
+    else
+#endif
+    {
+        // not atomic, physical memory can only be read and written
+        value = ptedit_phys_read_pread(entry);
+        if (value == expected) {
+            ptedit_phys_write_pwrite(entry, desired);
+        }
+    }
+    if (observed) *observed = value;
+    if (value != expected) return 1;
     ptedit_invalidate_tlb_pid(pid, address);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+static int ptedit_pte_modify_range_flags(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask, size_t flags) {
+    int changed = 0;
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_t modify;
+        modify.pid = (size_t)pid;
+        modify.vaddr = (size_t)address;
+        modify.length = length;
+        modify.set_mask = set_mask;
+        modify.clear_mask = clear_mask;
+        modify.flags = flags;
+        return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_PTE_MODIFY_RANGE, (size_t)&modify);
+    }
+#endif
+    size_t start = (size_t)address & ~((size_t)ptedit_pagesize - 1);
+    size_t pages = ((size_t)address + length - start + ptedit_pagesize - 1) / ptedit_pagesize;
+    ptedit_entry_t* entries = (ptedit_entry_t*)malloc(pages * sizeof(ptedit_entry_t));
+    size_t i;
+    if (!entries) return -1;
+    pages = ptedit_resolve_range(address, length, pid, entries);
+    for (i = 0; i < pages; i++) {
+        size_t pte = (entries[i].pte & ~clear_mask) | set_mask;
+        if (!(entries[i].valid & PTEDIT_VALID_MASK_PTE) || pte == entries[i].pte) continue;
+        if (!(flags & PTEDITOR_MODIFY_NON_PRESENT) && ptedit_cast(entries[i].pte, ptedit_pte_t).present != PTEDIT_PAGE_PRESENT) continue;
+        entries[i].pte = pte;
+        entries[i].valid = PTEDIT_VALID_MASK_PTE;
+        entries[changed++] = entries[i];
+    }
+    ptedit_update_batch(entries, changed, pid);
+    free(entries);
+    return changed;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_pte_modify_range(void* address, size_t length, pid_t pid, size_t set_mask, size_t clear_mask) {
+    return ptedit_pte_modify_range_flags(address, length, pid, set_mask, clear_mask, 0);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_lock_range(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_lock_range_t range;
+    range.pid = (size_t)pid;
+    range.vaddr = (size_t)address;
+    range.length = length;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_LOCK_RANGE, (size_t)&range) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_unlock_range() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UNLOCK, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_get_resolve_stats(ptedit_resolve_stats_t* stats) {
+#if defined(LINUX)
+    if (!stats) return -1;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RESOLVE_STATS, (size_t)stats) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_bench(void* address, pid_t pid, int op, size_t iterations, ptedit_bench_t* result) {
+#if defined(LINUX)
+    if (!result) return -1;
+    result->pid = (size_t)pid;
+    result->vaddr = (size_t)address;
+    result->op = (size_t)op;
+    result->iterations = iterations;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_BENCH, (size_t)result) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_page_table_span(void* address, size_t length) {
+    size_t region = (size_t)ptedit_pagesize / sizeof(size_t) * ptedit_pagesize;
+    size_t start = (size_t)address & ~(region - 1);
+    return ((size_t)address + length - 1 - start) / region + 1;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t* ptedit_map_page_tables(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_pt_map_t range;
+    size_t entries = (size_t)ptedit_pagesize / sizeof(size_t);
+    char* tables;
+    range.pid = (size_t)pid;
+    range.vaddr = (size_t)address;
+    range.length = length;
+    if (!length || ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_PT_MAP, (size_t)&range)) return NULL;
+    tables = (char*)mmap(NULL, ptedit_page_table_span(address, length) * ptedit_pagesize, PROT_READ | PROT_WRITE, MAP_SHARED, ptedit_fd, PTEDITOR_MMAP_PAGE_TABLES);
+    if (tables == MAP_FAILED) return NULL;
+    return (size_t*)tables + (((size_t)address / ptedit_pagesize) & (entries - 1));
+#else
+    NO_WINDOWS_SUPPORT;
+    return NULL;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_unmap_page_tables(size_t* ptes, void* address, size_t length) {
+#if defined(LINUX)
+    char* tables = (char*)((size_t)ptes & ~((size_t)ptedit_pagesize - 1));
+    if (!ptes) return;
+    munmap(tables, ptedit_page_table_span(address, length) * ptedit_pagesize);
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_dump_open(pid_t pid) {
+#if defined(LINUX)
+    int fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_DUMP_OPEN, (size_t)pid);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc long ptedit_harvest(void* address, size_t length, pid_t pid, size_t flags, unsigned char* accessed, unsigned char* dirty) {
+#if defined(LINUX)
+    ptedit_harvest_t harvest;
+    long young;
+    harvest.pid = (size_t)pid;
+    harvest.vaddr = (size_t)address;
+    harvest.length = length;
+    harvest.flags = flags;
+    harvest.accessed = accessed;
+    harvest.dirty = dirty;
+    young = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_HARVEST, (size_t)&harvest);
+    return (young < 0) ? -1 : young;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_watch_open(void* address, size_t length, pid_t pid) {
+#if defined(LINUX)
+    ptedit_watch_t watch;
+    int fd;
+    watch.pid = (size_t)pid;
+    watch.vaddr = (size_t)address;
+    watch.length = length;
+    fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_WATCH_OPEN, (size_t)&watch);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_pte_file_open(pid_t pid) {
+#if defined(LINUX)
+    int fd = ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_PTE_FILE_OPEN, (size_t)pid);
+    return (fd < 0) ? -1 : fd;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_attach(pid_t pid) {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_ATTACH, (size_t)pid) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_detach() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_DETACH, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_txn_begin() {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_TXN_BEGIN, 0) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_txn_commit() {
+#if defined(LINUX)
+    ptedit_txn_t result;
+    if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_TXN_COMMIT, (size_t)&result)) {
+        return 0;
+    }
+    return result.requested - result.issued;
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
 }
 
 // ---------------------------------------------------------------------------
@@ -1502,6 +2823,10 @@ ptedit_fnc int ptedit_init() {
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_cleanup() {
 #if defined(LINUX)
+    if (ptedit_ring) {
+        munmap(ptedit_ring, sizeof(ptedit_ring_t));
+        ptedit_ring = NULL;
+    }
     if (ptedit_fd >= 0) {
         close(ptedit_fd);
     }
@@ -1520,6 +2845,29 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
 #if defined(LINUX)
         ptedit_resolve = ptedit_resolve_kernel;
         ptedit_update = ptedit_update_kernel;
+        ptedit_resolve_range = ptedit_resolve_range_kernel;
+#else
+        fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: PTEditor implementation not supported on Windows");
+#endif
+    }
+    else if (implementation == PTEDIT_IMPL_KERNEL_RING) {
+#if defined(LINUX)
+        if (!ptedit_ring) {
+            if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_RING_SETUP, PTEDITOR_RING_SQPOLL)) {
+                fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET " Error: Could not set up the command ring\n");
+                return;
+            }
+            ptedit_ring = (ptedit_ring_t*)mmap(NULL, sizeof(ptedit_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, ptedit_fd, 0);
+            if (ptedit_ring == MAP_FAILED) {
+                ptedit_ring = NULL;
+                fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET " Error: Could not map the command ring\n");
+                return;
+            }
+            ptedit_ring_tail = 0;
+        }
+        ptedit_resolve = ptedit_resolve_kernel_ring;
+        ptedit_update = ptedit_update_kernel_ring;
+        ptedit_resolve_range = ptedit_resolve_range_kernel;
 #else
         fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: PTEditor implementation not supported on Windows");
 #endif
@@ -1527,12 +2875,14 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
     else if (implementation == PTEDIT_IMPL_USER_PREAD) {
         ptedit_resolve = ptedit_resolve_user;
         ptedit_update = ptedit_update_user;
+        ptedit_resolve_range = ptedit_resolve_range_user;
         ptedit_paging_root = ptedit_get_paging_root(0);
     }
     else if (implementation == PTEDIT_IMPL_USER) {
 #if defined(LINUX)
         ptedit_resolve = ptedit_resolve_user_map;
         ptedit_update = ptedit_update_user_map;
+        ptedit_resolve_range = ptedit_resolve_range_user_map;
         ptedit_paging_root = ptedit_get_paging_root(0);
         if (!ptedit_vmem) {
             ptedit_vmem = (unsigned char*)mmap(NULL, 32ull << 30ull, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, ptedit_umem, 0);
@@ -1547,6 +2897,18 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
     }
 }
 
+#if defined(LINUX) && defined(IORING_SETUP_SQE128)
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_uring_prep(struct io_uring_sqe* sqe, unsigned int cmd, void* request) {
+    __u64 arg = (size_t)request;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = ptedit_fd;
+    sqe->cmd_op = cmd;
+    memcpy(sqe->cmd, &arg, sizeof(arg));
+}
+#endif
+
 
 // ---------------------------------------------------------------------------
 ptedit_fnc int ptedit_get_pagesize() {
@@ -1609,6 +2971,97 @@ ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content) {
 #endif
 }
 
+// ---------------------------------------------------------------------------
+static size_t ptedit_transfer_physical_pages(ptedit_phys_iovec_t* iov, size_t count, int write) {
+    size_t pages = 0;
+#if defined(LINUX)
+    size_t i;
+    if (ptedit_umem > 0) {
+        for (i = 0; i < count; i++) {
+            size_t size = iov[i].count * ptedit_pagesize;
+            ssize_t copied = write ? pwrite(ptedit_umem, iov[i].buffer, size, iov[i].pfn * ptedit_pagesize)
+                                   : pread(ptedit_umem, iov[i].buffer, size, iov[i].pfn * ptedit_pagesize);
+            if (copied != (ssize_t)size) return 0;
+            pages += iov[i].count;
+        }
+    }
+    else {
+        ptedit_phys_batch_t batch;
+        for (i = 0; i < count; i += batch.count) {
+            long copied;
+            batch.iov = iov + i;
+            batch.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+            copied = ioctl(ptedit_fd, write ? PTEDITOR_IOCTL_CMD_WRITE_PAGES : PTEDITOR_IOCTL_CMD_READ_PAGES, (size_t)&batch);
+            if (copied < 0) return 0;
+            pages += copied;
+        }
+    }
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+    return pages;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_read_physical_pages(ptedit_phys_iovec_t* iov, size_t count) {
+    return ptedit_transfer_physical_pages(iov, count, 0);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_write_physical_pages(ptedit_phys_iovec_t* iov, size_t count) {
+    return ptedit_transfer_physical_pages(iov, count, 1);
+}
+
+// ---------------------------------------------------------------------------
+#if defined(LINUX)
+static size_t ptedit_physical_op(unsigned long cmd, size_t* dst, size_t* src, size_t count, size_t pattern) {
+    size_t pages = 0;
+    ptedit_phys_op_t op;
+    size_t i;
+    op.pattern = pattern;
+    for (i = 0; i < count; i += op.count) {
+        long done;
+        op.count = (count - i > PTEDITOR_BATCH_MAX) ? PTEDITOR_BATCH_MAX : (count - i);
+        op.dst = dst + i;
+        op.src = src ? src + i : NULL;
+        done = ioctl(ptedit_fd, cmd, (size_t)&op);
+        if (done < 0) return 0;
+        pages += done;
+    }
+    return pages;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_copy_physical_pages(size_t* dst, size_t* src, size_t count) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_COPY_PAGES, dst, src, count, 0);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_fill_physical_pages(size_t* pfns, size_t count, size_t pattern) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_FILL_PAGES, pfns, NULL, count, pattern);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_clear_physical_pages(size_t* pfns, size_t count) {
+#if defined(LINUX)
+    return ptedit_physical_op(PTEDITOR_IOCTL_CMD_CLEAR_PAGES, pfns, NULL, count, 0);
+#else
+    NO_WINDOWS_SUPPORT;
+    return 0;
+#endif
+}
+
 
 // ---------------------------------------------------------------------------
 size_t ptedit_get_paging_root(pid_t pid) {
@@ -1659,6 +3112,41 @@ ptedit_fnc void ptedit_invalidate_tlb_pid(pid_t pid, void* address) {
 #endif
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_invalidate_tlb_range(pid_t pid, void* address, size_t length, size_t stride, int scope) {
+#if defined(LINUX)
+    ptedit_invalidate_tlb_range_t range;
+    range.pid = (size_t)pid;
+    range.start = (size_t)address;
+    range.end = (size_t)address + length;
+    range.stride = stride;
+    range.scope = (size_t)scope;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE, (size_t)&range) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_shootdown(ptedit_shootdown_range_t* ranges, size_t count) {
+#if defined(LINUX)
+    ptedit_shootdown_t shootdown;
+    shootdown.count = count;
+    shootdown.ranges = ranges;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_SHOOTDOWN, (size_t)&shootdown) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT;
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_invalidate_tlb_mm(pid_t pid, int scope) {
+    // a range larger than the flush threshold invalidates the entire address space
+    return ptedit_invalidate_tlb_range(pid, NULL, ~(size_t)0, 0, scope);
+}
+
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_invalidate_tlb(void* address) {
     // we do not directly call ptedit_invalidate_tlb_pid to ensure that the old
@@ -1896,6 +3384,12 @@ ptedit_fnc void ptedit_full_serializing_barrier() {
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit) {
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_flags(address, 1, pid, 1ull << bit, 0, PTEDITOR_MODIFY_NON_PRESENT);
+        return;
+    }
+#endif
     ptedit_entry_t vm = ptedit_resolve(address, pid);
     if (!(vm.valid & PTEDIT_VALID_MASK_PTE)) return;
     vm.pte |= (1ull << bit);
@@ -1905,6 +3399,12 @@ ptedit_fnc void ptedit_pte_set_bit(void* address, pid_t pid, int bit) {
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_pte_clear_bit(void* address, pid_t pid, int bit) {
+#if defined(LINUX)
+    if (ptedit_update == ptedit_update_kernel) {
+        ptedit_pte_modify_range_flags(address, 1, pid, 0, 1ull << bit, PTEDITOR_MODIFY_NON_PRESENT);
+        return;
+    }
+#endif
     ptedit_entry_t vm = ptedit_resolve(address, pid);
     if (!(vm.valid & PTEDIT_VALID_MASK_PTE)) return;
     vm.pte &= ~(1ull << bit);
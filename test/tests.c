@@ -150,6 +150,168 @@ UTEST(resolve, resolve_page_offset) {
     ASSERT_TRUE(entry_equal(&vm1, &vm4));
 }
 
+UTEST(resolve, resolve_batch) {
+    void* addresses[] = { page1, page2, scratch, 0 };
+    ptedit_entry_t entries[4];
+    int i;
+    ASSERT_EQ(ptedit_resolve_batch(addresses, 4, 0, entries), 0);
+    for(i = 0; i < 4; i++) {
+        ptedit_entry_t vm = ptedit_resolve(addresses[i], 0);
+        ASSERT_EQ(entries[i].vaddr, (size_t)addresses[i]);
+        ASSERT_EQ(entries[i].valid, vm.valid);
+        ASSERT_TRUE(entry_equal(&entries[i], &vm));
+    }
+}
+
+UTEST(resolve, resolve_range) {
+    size_t pages = 8, i;
+    char* mapping = (char*)mmap(0, pages * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(mapping != MAP_FAILED);
+    mapping[0] = 1;
+    mapping[3 * 4096] = 1;
+    munmap(mapping + 5 * 4096, 4096);
+    ptedit_entry_t entries[8];
+    ASSERT_EQ(ptedit_resolve_range(mapping + 1, pages * 4096 - 1, 0, entries), pages);
+    for(i = 0; i < pages; i++) {
+        ptedit_entry_t vm = ptedit_resolve(mapping + i * 4096, 0);
+        ASSERT_EQ(entries[i].vaddr, (size_t)(mapping + i * 4096));
+        ASSERT_EQ(entries[i].valid, vm.valid);
+        ASSERT_TRUE(entry_equal(&entries[i], &vm));
+    }
+    munmap(mapping, pages * 4096);
+}
+
+UTEST(resolve, resolve_lockless) {
+    ptedit_resolve_stats_t before, after;
+    ASSERT_EQ(ptedit_get_resolve_stats(&before), 0);
+    ptedit_entry_t vm = ptedit_resolve(scratch, 0);
+    ASSERT_EQ(ptedit_get_resolve_stats(&after), 0);
+    ASSERT_TRUE(vm.pte != 0);
+    ASSERT_EQ(after.path[PTEDITOR_RESOLVE_PATH_IRQ], before.path[PTEDITOR_RESOLVE_PATH_IRQ] + 1);
+    ASSERT_EQ(after.path[PTEDITOR_RESOLVE_PATH_LOCKED], before.path[PTEDITOR_RESOLVE_PATH_LOCKED]);
+}
+
+UTEST(resolve, bench) {
+    ptedit_bench_t bench;
+    size_t pte = ptedit_resolve(scratch, 0).pte;
+    ASSERT_EQ(ptedit_bench(scratch, 0, PTEDITOR_BENCH_RESOLVE, 100, &bench), 0);
+    ASSERT_TRUE(bench.walk > 0);
+    ASSERT_EQ(bench.flush, 0);
+    ASSERT_EQ(ptedit_bench(scratch, 0, PTEDITOR_BENCH_UPDATE, 100, &bench), 0);
+    ASSERT_TRUE(bench.flush > 0);
+    ASSERT_EQ(ptedit_resolve(scratch, 0).pte, pte);
+    ASSERT_EQ(ptedit_bench(scratch, 0, PTEDITOR_BENCH_FLUSH + 1, 1, &bench), -1);
+}
+
+#if defined(IORING_SETUP_SQE128)
+#include <sys/syscall.h>
+#include <errno.h>
+
+UTEST(resolve, uring_cmd) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ring = syscall(__NR_io_uring_setup, 1, &params);
+    if(ring < 0) return; // io_uring not available
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    char* sq = (char*)mmap(0, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    char* cq = (char*)mmap(0, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    struct io_uring_sqe* sqes = (struct io_uring_sqe*)mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    ASSERT_TRUE(sq != MAP_FAILED && cq != MAP_FAILED && sqes != MAP_FAILED);
+
+    ptedit_entry_t vm;
+    memset(&vm, 0, sizeof(vm));
+    vm.vaddr = (size_t)scratch;
+    ptedit_uring_prep(&sqes[0], PTEDITOR_IOCTL_CMD_VM_RESOLVE, &vm);
+    unsigned tail = *(unsigned*)(sq + params.sq_off.tail);
+    ((unsigned*)(sq + params.sq_off.array))[tail & *(unsigned*)(sq + params.sq_off.ring_mask)] = 0;
+    __atomic_store_n((unsigned*)(sq + params.sq_off.tail), tail + 1, __ATOMIC_RELEASE);
+    ASSERT_EQ(syscall(__NR_io_uring_enter, ring, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0), 1);
+
+    unsigned head = __atomic_load_n((unsigned*)(cq + params.cq_off.head), __ATOMIC_ACQUIRE);
+    struct io_uring_cqe* cqe = (struct io_uring_cqe*)(cq + params.cq_off.cqes) + (head & *(unsigned*)(cq + params.cq_off.ring_mask));
+    if(cqe->res != -EOPNOTSUPP) { // module without io_uring support
+        ptedit_entry_t expected = ptedit_resolve(scratch, 0);
+        ASSERT_TRUE(cqe->res >= 0);
+        ASSERT_TRUE(entry_equal(&vm, &expected));
+    }
+
+    munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+    munmap(cq, cq_size);
+    munmap(sq, sq_size);
+    close(ring);
+}
+#endif
+
+UTEST(resolve, kernel_ring) {
+    ptedit_entry_t vm1 = ptedit_resolve(scratch, 0);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL_RING);
+    ptedit_entry_t vm2 = ptedit_resolve(scratch, 0);
+    ptedit_entry_t vm3 = ptedit_resolve(scratch, 0);
+    vm3.valid = PTEDIT_VALID_MASK_PTE;
+    ptedit_update(scratch, 0, &vm3);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    ptedit_entry_t vm4 = ptedit_resolve(scratch, 0);
+    ASSERT_TRUE(entry_equal(&vm1, &vm2));
+    ASSERT_TRUE(entry_equal(&vm1, &vm4));
+}
+
+UTEST(resolve, dump) {
+    ptedit_dump_header_t header;
+    ptedit_dump_record_t records[256];
+    ptedit_entry_t vm = ptedit_resolve(scratch, 0);
+    int found = 0;
+    ssize_t n;
+    int fd = ptedit_dump_open(0);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQ(read(fd, &header, sizeof(header)), (ssize_t)sizeof(header));
+    ASSERT_EQ(header.magic, (size_t)PTEDITOR_DUMP_MAGIC);
+    ASSERT_EQ(header.version, (size_t)PTEDITOR_DUMP_VERSION);
+    ASSERT_EQ(header.record_size, sizeof(ptedit_dump_record_t));
+    while((n = read(fd, records, sizeof(records))) > 0) {
+        size_t i;
+        for(i = 0; i < n / sizeof(ptedit_dump_record_t); i++) {
+            if(records[i].level == PTEDIT_VALID_MASK_PTE && records[i].vaddr == (size_t)scratch) {
+                found = (ptedit_get_pfn(records[i].entry) == ptedit_get_pfn(vm.pte));
+            }
+        }
+    }
+    close(fd);
+    ASSERT_TRUE(found);
+}
+
+#if defined(LINUX)
+#include <poll.h>
+
+UTEST(resolve, watch) {
+    ptedit_watch_record_t record;
+    struct pollfd pfd;
+    char* page = (char*)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(page != MAP_FAILED);
+    page[0] = 1;
+    pfd.fd = ptedit_watch_open(page, 4096, 0);
+    pfd.events = POLLIN;
+    ASSERT_TRUE(pfd.fd >= 0);
+    madvise(page, 4096, MADV_DONTNEED);
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+    ASSERT_EQ(read(pfd.fd, &record, sizeof(record)), (ssize_t)sizeof(record));
+    ASSERT_EQ(record.start, (size_t)page);
+    ASSERT_EQ(record.end, (size_t)page + 4096);
+    close(pfd.fd);
+    munmap(page, 4096);
+}
+#endif
+
+UTEST(resolve, attach) {
+    ptedit_entry_t vm1 = ptedit_resolve(scratch, 0);
+    ASSERT_EQ(ptedit_attach(getpid()), 0);
+    ASSERT_NE(ptedit_attach(getpid()), 0);
+    ptedit_entry_t vm2 = ptedit_resolve(scratch, getpid());
+    ASSERT_TRUE(entry_equal(&vm1, &vm2));
+    ASSERT_EQ(ptedit_detach(), 0);
+    ASSERT_NE(ptedit_detach(), 0);
+}
+
 
 // =========================================================================
 //                             Updating addresses
@@ -197,6 +359,152 @@ UTEST(update, new_pte) {
     ptedit_entry_t vm2 = ptedit_resolve(scratch, 0);
     ASSERT_TRUE(entry_equal(&vm, &vm2));
 }
+UTEST(update, batch) {
+    ptedit_entry_t entries[2];
+    entries[0] = ptedit_resolve(accessor, 0);
+    entries[1] = ptedit_resolve(scratch, 0);
+    ASSERT_TRUE(entries[0].valid & PTEDIT_VALID_MASK_PTE);
+    ASSERT_TRUE(entries[1].valid & PTEDIT_VALID_MASK_PTE);
+    size_t accessor_pte = entries[0].pte;
+    entries[0].pte = ptedit_set_pfn(entries[0].pte, ptedit_pte_get_pfn(page1, 0));
+    entries[0].valid = entries[1].valid = PTEDIT_VALID_MASK_PTE;
+    ASSERT_EQ(ptedit_update_batch(entries, 2, 0), 0);
+    ASSERT_TRUE(accessor[0] == 0);
+
+    entries[0].pte = accessor_pte;
+    ASSERT_EQ(ptedit_update_batch(entries, 2, 0), 0);
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_entry_t check = ptedit_resolve(scratch, 0);
+    ASSERT_EQ(check.pte, entries[1].pte);
+}
+
+UTEST(update, lock_range) {
+    ptedit_entry_t vm = ptedit_resolve(accessor, 0);
+    size_t accessor_pte = vm.pte;
+    ASSERT_EQ(ptedit_lock_range(accessor, sizeof(accessor), 0), 0);
+    ASSERT_NE(ptedit_lock_range(accessor, sizeof(accessor), 0), 0);
+    vm.pte = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    vm.valid = PTEDIT_VALID_MASK_PTE;
+    ptedit_update(accessor, 0, &vm);
+    ASSERT_TRUE(accessor[0] == 0);
+    vm.pte = accessor_pte;
+    ptedit_update(accessor, 0, &vm);
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_EQ(ptedit_unlock_range(), 0);
+    ASSERT_NE(ptedit_unlock_range(), 0);
+}
+
+#include <errno.h>
+
+UTEST(update, lock_range_stale) {
+    ASSERT_EQ(ptedit_lock_range(accessor, sizeof(accessor), 0), 0);
+    ptedit_entry_t vm = ptedit_resolve(accessor, 0);
+    // Changing the protection of the range invalidates the resolved entry
+    ASSERT_EQ(mprotect(accessor, sizeof(accessor), PROT_READ), 0);
+    ASSERT_EQ(mprotect(accessor, sizeof(accessor), PROT_READ | PROT_WRITE), 0);
+    vm.pte = ptedit_set_pfn(vm.pte, ptedit_pte_get_pfn(page1, 0));
+    vm.valid = PTEDIT_VALID_MASK_PTE;
+    errno = 0;
+    ptedit_update(accessor, 0, &vm);
+    ASSERT_EQ(errno, EAGAIN);
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_EQ(ptedit_unlock_range(), 0);
+}
+
+UTEST(update, map_page_tables) {
+    ptedit_entry_t vm = ptedit_resolve(accessor, 0);
+    size_t accessor_pte = vm.pte;
+    size_t* ptes = ptedit_map_page_tables(accessor, sizeof(accessor), 0);
+    ASSERT_TRUE(ptes != NULL);
+    ASSERT_EQ(ptedit_pte_get_pfn(accessor, 0), ptedit_get_pfn(ptes[0]));
+    ptes[0] = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    ptedit_invalidate_tlb(accessor);
+    ASSERT_TRUE(accessor[0] == 0);
+    ptes[0] = accessor_pte;
+    ptedit_invalidate_tlb(accessor);
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_unmap_page_tables(ptes, accessor, sizeof(accessor));
+}
+
+UTEST(update, harvest) {
+    unsigned char accessed[1], dirty[1];
+    accessor[1] = 1;
+    ASSERT_EQ(ptedit_harvest(accessor, sizeof(accessor), 0, PTEDITOR_HARVEST_CLEAR_ACCESSED | PTEDITOR_HARVEST_CLEAR_DIRTY, accessed, dirty), 1);
+    ASSERT_EQ(accessed[0], 1);
+    ASSERT_FALSE(ptedit_pte_get_bit(accessor, 0, PTEDIT_PAGE_BIT_ACCESSED));
+    ASSERT_FALSE(ptedit_pte_get_bit(accessor, 0, PTEDIT_PAGE_BIT_DIRTY));
+    accessor[1] = 1;
+    ASSERT_EQ(ptedit_harvest(accessor, sizeof(accessor), 0, 0, accessed, dirty), 1);
+    ASSERT_EQ(accessed[0], 1);
+    ASSERT_EQ(dirty[0], 1);
+}
+
+UTEST(update, pte_file) {
+    size_t accessor_pte, pte;
+    off_t offset = ((size_t)accessor / ptedit_get_pagesize()) * sizeof(size_t);
+    int fd = ptedit_pte_file_open(0);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQ(pread(fd, &accessor_pte, sizeof(size_t), offset), (ssize_t)sizeof(size_t));
+    ASSERT_EQ(accessor_pte, ptedit_resolve(accessor, 0).pte);
+    pte = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    ASSERT_EQ(pwrite(fd, &pte, sizeof(size_t), offset), (ssize_t)sizeof(size_t));
+    ASSERT_TRUE(accessor[0] == 0);
+    ASSERT_EQ(pwrite(fd, &accessor_pte, sizeof(size_t), offset), (ssize_t)sizeof(size_t));
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_NE(pread(fd, &pte, 1, offset), (ssize_t)1);
+    // offsets beyond the address space are the end of the file, not a wrapped-around address
+    ASSERT_EQ(pread(fd, &pte, sizeof(size_t), (off_t)1 << 60), (ssize_t)0);
+    // the zero page is not mapped, there is no PTE to write
+    ASSERT_EQ(pwrite(fd, &accessor_pte, sizeof(size_t), 0), (ssize_t)-1);
+    close(fd);
+}
+
+UTEST(update, invalidate_tlb_range) {
+    size_t accessor_pte = ptedit_resolve(accessor, 0).pte;
+    size_t* ptes = ptedit_map_page_tables(accessor, sizeof(accessor), 0);
+    ASSERT_TRUE(ptes != NULL);
+    ptes[0] = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    ASSERT_EQ(ptedit_invalidate_tlb_range(0, accessor, sizeof(accessor), 0, PTEDITOR_TLB_SCOPE_MM), 0);
+    ASSERT_TRUE(accessor[0] == 0);
+    ptes[0] = accessor_pte;
+    ASSERT_EQ(ptedit_invalidate_tlb_mm(0, PTEDITOR_TLB_SCOPE_ALL), 0);
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_NE(ptedit_invalidate_tlb_range(0, accessor, sizeof(accessor), 12345, PTEDITOR_TLB_SCOPE_MM), 0);
+    ptedit_unmap_page_tables(ptes, accessor, sizeof(accessor));
+}
+
+UTEST(update, shootdown) {
+    ptedit_shootdown_range_t ranges[2];
+    size_t accessor_pte = ptedit_resolve(accessor, 0).pte;
+    size_t* ptes = ptedit_map_page_tables(accessor, sizeof(accessor), 0);
+    ASSERT_TRUE(ptes != NULL);
+    ranges[0].pid = ranges[1].pid = 0;
+    ranges[0].start = (size_t)scratch;
+    ranges[0].end = (size_t)scratch + sizeof(scratch);
+    ranges[1].start = (size_t)accessor;
+    ranges[1].end = (size_t)accessor + sizeof(accessor);
+    ptes[0] = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    ASSERT_EQ(ptedit_shootdown(ranges, 2), 0);
+    ASSERT_TRUE(accessor[0] == 0);
+    ptes[0] = accessor_pte;
+    ASSERT_EQ(ptedit_shootdown(ranges, 2), 0);
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_unmap_page_tables(ptes, accessor, sizeof(accessor));
+}
+
+UTEST(update, cmpxchg) {
+    ptedit_entry_t vm = ptedit_resolve(accessor, 0);
+    ASSERT_TRUE(vm.valid & PTEDIT_VALID_MASK_PTE);
+    size_t remapped = ptedit_set_pfn(vm.pte, ptedit_pte_get_pfn(page1, 0)), observed = 0;
+    ASSERT_EQ(ptedit_cmpxchg(accessor, 0, PTEDIT_VALID_MASK_PTE, vm.pte ^ 1, remapped, &observed), 1);
+    ASSERT_EQ(observed, vm.pte);
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_EQ(ptedit_cmpxchg(accessor, 0, PTEDIT_VALID_MASK_PTE, vm.pte, remapped, &observed), 0);
+    ASSERT_TRUE(accessor[0] == 0);
+    ASSERT_EQ(ptedit_cmpxchg(accessor, 0, PTEDIT_VALID_MASK_PTE, remapped, vm.pte, NULL), 0);
+    ASSERT_TRUE(accessor[0] == 2);
+}
+
 
 // =========================================================================
 //                                  PTEs
@@ -247,6 +555,37 @@ UTEST(pte, pte_set_pfn) {
     ASSERT_TRUE(accessor[0] == 2);
 }
 
+UTEST(pte, modify_range) {
+    size_t pages = 4, i;
+    char* mapping = (char*)mmap(0, pages * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_TRUE(mapping != MAP_FAILED);
+    size_t mask = 1ull << PTEDIT_PAGE_BIT_SOFTW4;
+    ASSERT_EQ(ptedit_pte_modify_range(mapping, pages * 4096, 0, mask, 0), (int)pages);
+    ASSERT_EQ(ptedit_pte_modify_range(mapping, pages * 4096, 0, mask, 0), 0);
+    for(i = 0; i < pages; i++) {
+        ASSERT_TRUE(ptedit_pte_get_bit(mapping + i * 4096, 0, PTEDIT_PAGE_BIT_SOFTW4));
+    }
+    ASSERT_EQ(ptedit_pte_modify_range(mapping, pages * 4096, 0, 0, mask), (int)pages);
+    for(i = 0; i < pages; i++) {
+        ASSERT_FALSE(ptedit_pte_get_bit(mapping + i * 4096, 0, PTEDIT_PAGE_BIT_SOFTW4));
+    }
+    munmap(mapping, pages * 4096);
+}
+
+UTEST(pte, clear_set_present) {
+    char* mapping = (char*)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_TRUE(mapping != MAP_FAILED);
+    mapping[0] = 3;
+    ptedit_pte_clear_bit(mapping, 0, PTEDIT_PAGE_BIT_PRESENT);
+    ASSERT_FALSE(ptedit_pte_get_bit(mapping, 0, PTEDIT_PAGE_BIT_PRESENT));
+    /* Non-present PTEs are only modified by the single-address functions */
+    ASSERT_EQ(ptedit_pte_modify_range(mapping, 4096, 0, 1ull << PTEDIT_PAGE_BIT_PRESENT, 0), 0);
+    ptedit_pte_set_bit(mapping, 0, PTEDIT_PAGE_BIT_PRESENT);
+    ASSERT_TRUE(ptedit_pte_get_bit(mapping, 0, PTEDIT_PAGE_BIT_PRESENT));
+    ASSERT_TRUE(mapping[0] == 3);
+    munmap(mapping, 4096);
+}
+
 
 // =========================================================================
 //                             Physical Pages
@@ -276,6 +615,40 @@ UTEST(page, write) {
     ASSERT_TRUE(!memcmp(page2, buffer, sizeof(buffer)));
 }
 
+UTEST(page, vectored) {
+    char buffer[2][4096];
+    ptedit_phys_iovec_t iov[2];
+    iov[0].pfn = ptedit_pte_get_pfn(page1, 0);
+    iov[1].pfn = ptedit_pte_get_pfn(page2, 0);
+    iov[0].count = iov[1].count = 1;
+    iov[0].buffer = (unsigned char*)buffer[0];
+    iov[1].buffer = (unsigned char*)buffer[1];
+    ASSERT_EQ(ptedit_read_physical_pages(iov, 2), 2);
+    ASSERT_TRUE(!memcmp(page1, buffer[0], sizeof(buffer[0])));
+    ASSERT_TRUE(!memcmp(page2, buffer[1], sizeof(buffer[1])));
+
+    size_t pfn = ptedit_pte_get_pfn(scratch, 0);
+    iov[0].pfn = pfn;
+    ASSERT_EQ(ptedit_write_physical_pages(iov, 1), 1);
+    ASSERT_TRUE(!memcmp(page1, scratch, sizeof(scratch)));
+}
+
+UTEST(page, copy_fill_clear) {
+    size_t dst = ptedit_pte_get_pfn(scratch, 0);
+    size_t src = ptedit_pte_get_pfn(page2, 0);
+    size_t i;
+    ASSERT_EQ(ptedit_copy_physical_pages(&dst, &src, 1), 1);
+    ASSERT_TRUE(!memcmp(page2, scratch, sizeof(scratch)));
+    ASSERT_EQ(ptedit_fill_physical_pages(&dst, 1, 0x0123456789abcdefull), 1);
+    for(i = 0; i < sizeof(scratch) / sizeof(size_t); i++) {
+        ASSERT_EQ(((size_t*)scratch)[i], (size_t)0x0123456789abcdefull);
+    }
+    ASSERT_EQ(ptedit_clear_physical_pages(&dst, 1), 1);
+    for(i = 0; i < sizeof(scratch); i++) {
+        ASSERT_EQ(scratch[i], 0);
+    }
+}
+
 // =========================================================================
 //                                Paging
 // =========================================================================
@@ -433,6 +806,38 @@ UTEST(memtype, uncachable_huge_page_access_time) {
 //                               TLB
 // =========================================================================
 
+UTEST(tlb, transaction) {
+    ptedit_entry_t vm = ptedit_resolve(accessor, 0);
+    size_t accessor_pte = vm.pte;
+    ASSERT_EQ(ptedit_txn_begin(), 0);
+    ASSERT_NE(ptedit_txn_begin(), 0);
+    vm.pte = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page1, 0));
+    vm.valid = PTEDIT_VALID_MASK_PTE;
+    ptedit_update(accessor, 0, &vm);
+    vm.pte = ptedit_set_pfn(accessor_pte, ptedit_pte_get_pfn(page2, 0));
+    ptedit_update(accessor, 0, &vm);
+    ptedit_invalidate_tlb(scratch);
+    ASSERT_EQ(ptedit_txn_commit(), 2);
+    ASSERT_TRUE(accessor[0] == 1);
+    vm.pte = accessor_pte;
+    ptedit_update(accessor, 0, &vm);
+    ASSERT_TRUE(accessor[0] == 2);
+    ASSERT_EQ(ptedit_txn_commit(), 0);
+}
+
+#if defined(LINUX)
+UTEST(tlb, concurrent_open) {
+    int fd = open(PTEDITOR_DEVICE_PATH, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    // the invalidation method is per open file
+    ASSERT_EQ(ioctl(fd, PTEDITOR_IOCTL_CMD_SWITCH_TLB_INVALIDATION, PTEDITOR_TLB_INVALIDATION_KERNEL), 0);
+    ptedit_entry_t vm = ptedit_resolve(scratch, 0);
+    ASSERT_EQ(ioctl(fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE, (size_t)&vm), 0);
+    ASSERT_TRUE(vm.valid & PTEDIT_VALID_MASK_PTE);
+    close(fd);
+}
+#endif
+
 UTEST(tlb, invalid_tlb_invalidate_method) {
     int ret = ptedit_switch_tlb_invalidation(3);
     ASSERT_TRUE(ret);